@@ -0,0 +1,300 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: bounded channel. A lock free bounded queue with futex parking for
+//              the blocked consumer. It is made for the event edges of the dag, which
+//              have one publisher and one subscriber.
+
+#pragma once
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include "common/common.h"
+
+namespace crdc {
+namespace airi {
+namespace common {
+/**
+ * @class BoundedChannel
+ * @brief Lock free bounded queue. Each slot carries a sequence number which tells
+ *        whether it is ready to be written or read, so the data is handed over
+ *        without a lock. Both ends claim their positions by CAS: one producer and
+ *        one consumer is the fast path, and a rare extra producer (the wake event of
+ *        Operator::stop) or the producer dropping the stale data (clear) is still safe.
+ *        A blocked consumer (or producer of push()) spins for a while, then parks on
+ *        a futex which is only touched by the other end when somebody is parked.
+ * @param Data element type
+ */
+template <class Data>
+class BoundedChannel {
+ public:
+  explicit BoundedChannel(size_t max_count) : max_count_(max_count), capacity_(2) {
+    if (max_count_ < 1) {
+      max_count_ = 1;
+    }
+    // the sequence numbers need at least 2 slots to tell empty from full
+    while (capacity_ < max_count_) {
+      capacity_ <<= 1;
+    }
+    mask_ = capacity_ - 1;
+    slots_.reset(new Slot[capacity_]);
+    for (size_t i = 0; i < capacity_; ++i) {
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~BoundedChannel() = default;
+
+  // the channel keeps its head and tail on their own cache lines
+  ALIGNED_NEW(64);
+
+  /**
+   * @brief inserts element at the end
+   * @param data the value of the element to push
+   * @return false if the channel is full
+   * @note non-blocking
+   */
+  bool try_push(const Data& data) {
+    uint64_t pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      uint64_t tail = tail_.load(std::memory_order_acquire);
+      if (pos >= tail && pos - tail >= max_count_) {
+        return false;
+      }
+      Slot& slot = slots_[pos & mask_];
+      uint64_t seq = slot.seq.load(std::memory_order_acquire);
+      if (seq == pos) {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          slot.data = data;
+          slot.seq.store(pos + 1, std::memory_order_release);
+          wake(&pop_signal_, &pop_waiters_);
+          return true;
+        }
+      } else if (seq < pos) {
+        // there is room, but the slot is still being read by the consumer of the
+        // last round, which is about to finish.
+        std::this_thread::yield();
+        pos = head_.load(std::memory_order_relaxed);
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * @brief removes the first element
+   * @param[out] data value of the first element
+   * @note non-blocking
+   */
+  bool try_pop(Data* data) {
+    uint64_t pos = tail_.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = slots_[pos & mask_];
+      uint64_t seq = slot.seq.load(std::memory_order_acquire);
+      if (seq == pos + 1) {
+        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          *data = std::move(slot.data);
+          slot.seq.store(pos + capacity_, std::memory_order_release);
+          wake(&push_signal_, &push_waiters_);
+          return true;
+        }
+      } else if (seq < pos + 1) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * @brief inserts element at the end, waits for the room if the channel is full
+   * @param data the value of the element to push
+   * @param timeout_us the max time to wait
+   * @return false if the channel is still full after the timeout
+   */
+  bool push(const Data& data, int64_t timeout_us) {
+    for (int i = 0; i < kSpinCount; ++i) {
+      if (try_push(data)) {
+        return true;
+      }
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+    for (;;) {
+      uint32_t signal = push_signal_.load(std::memory_order_acquire);
+      push_waiters_.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (try_push(data)) {
+        push_waiters_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+      auto remain = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          deadline - std::chrono::steady_clock::now()).count();
+      if (remain <= 0) {
+        push_waiters_.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+      }
+      wait(&push_signal_, signal, remain);
+      push_waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief inserts element at the end, drops the oldest elements to make room
+   * @param data the value of the element to push
+   * @return the number of the dropped elements
+   */
+  size_t push_overwrite(const Data& data) {
+    size_t dropped = 0;
+    Data oldest;
+    while (!try_push(data)) {
+      if (try_pop(&oldest)) {
+        ++dropped;
+      }
+    }
+    return dropped;
+  }
+
+  /**
+   * @brief removes the first element
+   * @param[out] data value of the first element
+   * @note blocking if the channel is empty
+   */
+  void pop(Data* data) {
+    for (int i = 0; i < kSpinCount; ++i) {
+      if (try_pop(data)) {
+        return;
+      }
+    }
+    for (;;) {
+      uint32_t signal = pop_signal_.load(std::memory_order_acquire);
+      pop_waiters_.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (try_pop(data)) {
+        pop_waiters_.fetch_sub(1, std::memory_order_relaxed);
+        return;
+      }
+      wait(&pop_signal_, signal, -1);
+      pop_waiters_.fetch_sub(1, std::memory_order_relaxed);
+      if (try_pop(data)) {
+        return;
+      }
+    }
+  }
+
+  /**
+   * @brief removes the first element, waits for one if the channel is empty
+   * @param[out] data value of the first element
+   * @param timeout_us the max time to wait
+   * @return false if the channel is still empty after the timeout
+   */
+  bool pop(Data* data, int64_t timeout_us) {
+    for (int i = 0; i < kSpinCount; ++i) {
+      if (try_pop(data)) {
+        return true;
+      }
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+    for (;;) {
+      uint32_t signal = pop_signal_.load(std::memory_order_acquire);
+      pop_waiters_.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (try_pop(data)) {
+        pop_waiters_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+      auto remain = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          deadline - std::chrono::steady_clock::now()).count();
+      if (remain <= 0) {
+        pop_waiters_.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+      }
+      wait(&pop_signal_, signal, remain);
+      pop_waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief returns the number of elements
+   */
+  int size() const {
+    uint64_t tail = tail_.load(std::memory_order_acquire);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    return head > tail ? head - tail : 0;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  /**
+   * @brief checks whether the channel is full
+   */
+  bool full() const { return static_cast<size_t>(size()) >= max_count_; }
+
+  /**
+   * @brief remove all elements, could be called by the producer
+   */
+  void clear() {
+    Data data;
+    while (try_pop(&data)) {
+    }
+  }
+
+ private:
+  static const int kSpinCount = 64;
+
+  struct alignas(64) Slot {
+    ALIGNED_NEW(64);
+    std::atomic<uint64_t> seq{0};
+    Data data;
+  };
+
+  /**
+   * @brief park on the signal unless it has been bumped since it is loaded
+   * @param timeout_ns the max time to park, < 0 for no limit
+   */
+  static void wait(std::atomic<uint32_t>* signal, uint32_t value, int64_t timeout_ns) {
+    struct timespec ts;
+    ts.tv_sec = timeout_ns / 1000000000;
+    ts.tv_nsec = timeout_ns % 1000000000;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(signal), FUTEX_WAIT_PRIVATE, value,
+            timeout_ns < 0 ? nullptr : &ts, nullptr, 0);
+  }
+
+  /**
+   * @brief wake the parked threads. Pairs with the waiters increment before the
+   *        last try, either the waiter sees the change or it is seen here.
+   */
+  static void wake(std::atomic<uint32_t>* signal, std::atomic<uint32_t>* waiters) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters->load(std::memory_order_relaxed) == 0) {
+      return;
+    }
+    signal->fetch_add(1, std::memory_order_release);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(signal), FUTEX_WAKE_PRIVATE, INT32_MAX,
+            nullptr, nullptr, 0);
+  }
+
+  size_t max_count_;
+  size_t capacity_;
+  size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  alignas(64) std::atomic<uint64_t> head_{0};
+  alignas(64) std::atomic<uint64_t> tail_{0};
+  // bumped to wake the parked consumer / producer
+  alignas(64) std::atomic<uint32_t> pop_signal_{0};
+  std::atomic<uint32_t> pop_waiters_{0};
+  std::atomic<uint32_t> push_signal_{0};
+  std::atomic<uint32_t> push_waiters_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(BoundedChannel);
+};
+
+}  // namespace common
+}  // namespace airi
+}  // namespace crdc
@@ -5,6 +5,9 @@
 
 #pragma once
 
+#include <cstdlib>
+#include <new>
+
 // // A macro to disallow the copy constructor and operator= functions
 // // This should be used in the priavte:declarations for a class
 // #define DISALLOW_COPY_AND_ASSIGN(TypeName) \
@@ -12,4 +15,20 @@
 // void operator=(TypeName) = delete;
 
 #define likely(x) __builtin_expect(!!(x), 1)
-#define unlikely(x) __builtin_expect(!!(x), 0)
\ No newline at end of file
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+// The class-specific allocation of an over-aligned class, in its public declarations.
+// With -std=c++14 the new expressions ignore the alignas over the alignment of
+// std::max_align_t, so the cache-line padding only holds if the class allocates itself
+// aligned. The Itanium ABI pads the cookie of new[] to the alignment of the element.
+#define ALIGNED_NEW(Alignment)                                                     \
+  static void* operator new(std::size_t size) {                                    \
+    void* ptr = nullptr;                                                           \
+    if (posix_memalign(&ptr, (Alignment), size) != 0) {                            \
+      throw std::bad_alloc();                                                      \
+    }                                                                              \
+    return ptr;                                                                    \
+  }                                                                                \
+  static void* operator new[](std::size_t size) { return operator new(size); }     \
+  static void operator delete(void* ptr) { free(ptr); }                            \
+  static void operator delete[](void* ptr) { free(ptr); }
@@ -0,0 +1,178 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: bounded channel test
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "common/bounded_channel.h"
+
+namespace crdc {
+namespace airi {
+namespace common {
+
+using Clock = std::chrono::steady_clock;
+
+static int64_t elapsed_us(const Clock::time_point& start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+TEST(BoundedChannelTest, MaxCountIsNotRounded) {
+  // 3 slots of 4, the sequence numbers wrap around at the capacity
+  BoundedChannel<int> channel(3);
+  for (int round = 0; round < 100; ++round) {
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_TRUE(channel.try_push(round * 3 + i));
+    }
+    EXPECT_TRUE(channel.full());
+    EXPECT_FALSE(channel.try_push(-1));
+    for (int i = 0; i < 3; ++i) {
+      int data = -1;
+      EXPECT_TRUE(channel.try_pop(&data));
+      EXPECT_EQ(round * 3 + i, data);
+    }
+    EXPECT_TRUE(channel.empty());
+  }
+}
+
+TEST(BoundedChannelTest, WrapAroundInOrder) {
+  BoundedChannel<int> channel(4);
+  int next_push = 0;
+  int next_pop = 0;
+  // the positions go around the ring many times with a varying fill
+  for (int step = 0; step < 1000; ++step) {
+    for (int i = 0; i < step % 4 + 1 && channel.try_push(next_push); ++i) {
+      ++next_push;
+    }
+    int data = -1;
+    for (int i = 0; i < step % 3 + 1 && channel.try_pop(&data); ++i) {
+      EXPECT_EQ(next_pop++, data);
+    }
+    EXPECT_EQ(next_push - next_pop, channel.size());
+  }
+}
+
+TEST(BoundedChannelTest, LatestOverwritesTheMailbox) {
+  // LATEST is a channel of one, overwritten by push_overwrite
+  BoundedChannel<int> channel(1);
+  EXPECT_EQ(0u, channel.push_overwrite(1));
+  EXPECT_EQ(1u, channel.push_overwrite(2));
+  EXPECT_EQ(1u, channel.push_overwrite(3));
+  int data = -1;
+  EXPECT_TRUE(channel.try_pop(&data));
+  EXPECT_EQ(3, data);
+  EXPECT_FALSE(channel.try_pop(&data));
+}
+
+TEST(BoundedChannelTest, DropOldestKeepsTheNewest) {
+  BoundedChannel<int> channel(3);
+  size_t dropped = 0;
+  for (int i = 0; i < 10; ++i) {
+    dropped += channel.push_overwrite(i);
+  }
+  EXPECT_EQ(7u, dropped);
+  for (int i = 7; i < 10; ++i) {
+    int data = -1;
+    EXPECT_TRUE(channel.try_pop(&data));
+    EXPECT_EQ(i, data);
+  }
+}
+
+TEST(BoundedChannelTest, DropNewestAndClear) {
+  BoundedChannel<int> channel(2);
+  EXPECT_TRUE(channel.try_push(1));
+  EXPECT_TRUE(channel.try_push(2));
+  // DROP_NEWEST: the new one is refused
+  EXPECT_FALSE(channel.try_push(3));
+  // CLEAR: all dropped, then pushed
+  channel.clear();
+  EXPECT_TRUE(channel.empty());
+  EXPECT_TRUE(channel.try_push(4));
+  int data = -1;
+  EXPECT_TRUE(channel.try_pop(&data));
+  EXPECT_EQ(4, data);
+}
+
+TEST(BoundedChannelTest, BlockTimesOutWhenFull) {
+  BoundedChannel<int> channel(1);
+  EXPECT_TRUE(channel.try_push(1));
+  auto start = Clock::now();
+  EXPECT_FALSE(channel.push(2, 20000));
+  EXPECT_GE(elapsed_us(start), 20000);
+}
+
+TEST(BoundedChannelTest, PopTimesOutWhenEmpty) {
+  BoundedChannel<int> channel(1);
+  int data = -1;
+  auto start = Clock::now();
+  EXPECT_FALSE(channel.pop(&data, 20000));
+  EXPECT_GE(elapsed_us(start), 20000);
+}
+
+TEST(BoundedChannelTest, ParkedConsumerIsWoken) {
+  BoundedChannel<int> channel(2);
+  std::atomic<int> received{-1};
+  std::thread consumer([&] {
+    int data = -1;
+    channel.pop(&data);
+    received = data;
+  });
+  // long enough for the consumer to spin out and park
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(-1, received.load());
+  EXPECT_TRUE(channel.try_push(42));
+  consumer.join();
+  EXPECT_EQ(42, received.load());
+}
+
+TEST(BoundedChannelTest, ParkedProducerIsWoken) {
+  BoundedChannel<int> channel(1);
+  EXPECT_TRUE(channel.try_push(1));
+  std::atomic<bool> pushed{false};
+  std::thread producer([&] { pushed = channel.push(2, 10000000); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(pushed.load());
+  int data = -1;
+  EXPECT_TRUE(channel.try_pop(&data));
+  producer.join();
+  EXPECT_TRUE(pushed.load());
+  EXPECT_TRUE(channel.try_pop(&data));
+  EXPECT_EQ(2, data);
+}
+
+TEST(BoundedChannelTest, ProducersAndConsumerInOrder) {
+  static const int kCount = 100000;
+  BoundedChannel<int> channel(4);
+  // the extra producer of Operator::stop, each producer stays in order
+  std::vector<std::thread> producers;
+  for (int p = 0; p < 2; ++p) {
+    producers.emplace_back([&channel, p] {
+      for (int i = 0; i < kCount; ++i) {
+        while (!channel.push(p * kCount + i, 1000000)) {
+        }
+      }
+    });
+  }
+  int last[2] = {-1, -1};
+  for (int n = 0; n < 2 * kCount; ++n) {
+    int data = -1;
+    channel.pop(&data);
+    int p = data / kCount;
+    ASSERT_GT(data % kCount, last[p]);
+    last[p] = data % kCount;
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  EXPECT_TRUE(channel.empty());
+  EXPECT_EQ(kCount - 1, last[0]);
+  EXPECT_EQ(kCount - 1, last[1]);
+}
+
+}  // namespace common
+}  // namespace airi
+}  // namespace crdc
@@ -4,8 +4,14 @@
 // Description: thread
 
 
+#include <errno.h>
 #include <signal.h>
+#include <string.h>
 #include <glog/logging.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
 #include "common/thread.h"
 
 namespace crdc {
@@ -59,6 +65,103 @@ bool Thread::is_alive() {
   return true;
 }
 
+static const char* sched_policy_name(int policy) {
+  switch (policy) {
+    case SCHED_FIFO:
+      return "FIFO";
+    case SCHED_RR:
+      return "RR";
+    default:
+      return "OTHER";
+  }
+}
+
+void Thread::set_sched_policy(int policy, int rt_priority) {
+  if (policy != SCHED_FIFO && policy != SCHED_RR) {
+    sched_policy_ = SCHED_OTHER;
+    rt_priority_ = 0;
+    return;
+  }
+  sched_policy_ = policy;
+  rt_priority_ = std::min(std::max(rt_priority, sched_get_priority_min(policy)),
+                          sched_get_priority_max(policy));
+}
+
+std::vector<int> Thread::isolated_cpus() {
+  std::vector<int> cpus;
+  std::ifstream fin("/sys/devices/system/cpu/isolated");
+  std::string list;
+  if (!fin || !std::getline(fin, list)) {
+    return cpus;
+  }
+  // e.g. "2-3,6"
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty()) {
+      continue;
+    }
+    size_t dash = range.find('-');
+    int first = std::atoi(range.substr(0, dash).c_str());
+    int last = dash == std::string::npos ? first : std::atoi(range.substr(dash + 1).c_str());
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.emplace_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+void Thread::apply_placement() {
+  pthread_t self = pthread_self();
+  if (!cpus_.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus_) {
+      if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &set);
+      }
+    }
+    int result = pthread_setaffinity_np(self, sizeof(set), &set);
+    if (result != 0) {
+      LOG(WARNING) << thread_name_ << " failed to set cpu affinity: " << strerror(result);
+    }
+  }
+  if (sched_policy_ != SCHED_OTHER) {
+    struct sched_param param;
+    param.sched_priority = rt_priority_;
+    int result = pthread_setschedparam(self, sched_policy_, &param);
+    if (result != 0) {
+      LOG(WARNING) << thread_name_ << " failed to set SCHED_" << sched_policy_name(sched_policy_)
+                   << " (" << strerror(result) << "), fall back to SCHED_OTHER.";
+      sched_policy_ = SCHED_OTHER;
+      rt_priority_ = 0;
+    }
+  }
+  if (sched_policy_ == SCHED_OTHER) {
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), priority_);
+  }
+
+  // the effective placement
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  std::ostringstream cpus;
+  if (pthread_getaffinity_np(self, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus << cpu << " ";
+      }
+    }
+  }
+  int policy = SCHED_OTHER;
+  struct sched_param param;
+  param.sched_priority = 0;
+  pthread_getschedparam(self, &policy, &param);
+  LOG(INFO) << "Thread " << thread_name_ << " tid: " << syscall(SYS_gettid)
+            << " cpus: [ " << cpus.str() << "] policy: SCHED_" << sched_policy_name(policy)
+            << " rt_priority: " << param.sched_priority
+            << " nice: " << getpriority(PRIO_PROCESS, syscall(SYS_gettid));
+}
+
 void Thread::set_priority(int priority) {
   if (priority > 19) {
     priority = 19;
@@ -9,8 +9,10 @@
 #include <sys/syscall.h>
 #include <sys/resource.h>
 #include <pthread.h>
+#include <sched.h>
 #include <mutex>
 #include <string>
+#include <vector>
 #include "common/common.h"
 
 namespace crdc {
@@ -19,7 +21,8 @@ namespace common {
 class Thread {
  public:
   explicit Thread(bool joinable = false, const std::string& name = "Thread")
-    : tid_(0), started_(false), joinable_(joinable), priority_(0), thread_name_(name) {}
+    : tid_(0), started_(false), joinable_(joinable), priority_(0), thread_name_(name),
+      sched_policy_(SCHED_OTHER), rt_priority_(0) {}
 
   virtual ~Thread() = default;
 
@@ -53,22 +56,60 @@ class Thread {
     return priority_;
   }
 
+  /**
+   * @brief the cores the thread runs on, empty for all. Applied when it starts.
+   */
+  void set_cpu_affinity(const std::vector<int>& cpus) {
+    cpus_ = cpus;
+  }
+
+  const std::vector<int>& get_cpu_affinity() const {
+    return cpus_;
+  }
+
+  /**
+   * @brief the scheduling policy, applied when the thread starts. Falls back to
+   *        SCHED_OTHER with a warning if the process has no permission for RT.
+   * @param SCHED_OTHER, SCHED_FIFO or SCHED_RR
+   * @param the RT priority for SCHED_FIFO and SCHED_RR, [1, 99]
+   */
+  void set_sched_policy(int policy, int rt_priority);
+
+  int get_sched_policy() const {
+    return sched_policy_;
+  }
+
+  /**
+   * @brief the isolated cores of the system (isolcpus), from
+   *        /sys/devices/system/cpu/isolated
+   */
+  static std::vector<int> isolated_cpus();
+
  protected:
   virtual void run() {}
 
   static void* thread_runner(void* arg) {
     Thread* t = reinterpret_cast<Thread*>(arg);
-    setpriority(PRIO_PROCESS, syscall(SYS_gettid), t->get_priority());
+    t->apply_placement();
     t->run();
     return NULL;
   }
 
+  /**
+   * @brief apply the affinity, scheduling policy and priority in the thread itself,
+   *        then log the effective placement.
+   */
+  void apply_placement();
+
   pthread_t tid_;
   bool started_;
   bool joinable_;
   int priority_;
   std::string thread_name_;
   std::mutex mutex_;
+  std::vector<int> cpus_;
+  int sched_policy_;
+  int rt_priority_;
 
  private:
   DISALLOW_COPY_AND_ASSIGN(Thread);
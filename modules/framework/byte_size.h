@@ -0,0 +1,60 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: byte size. The bytes held by a payload of the cached data. It is used
+//              for the memory budget of the shared data.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include "common/common.h"
+
+namespace crdc {
+namespace airi {
+
+DEFINE_TYPE_TRAIT(HasByteSize, byte_size)  // NOLINT
+
+/**
+ * @brief The bytes of a payload. It is sizeof(T) by default, and the result of
+ *        `size_t T::byte_size() const` if T has one. Specialize it for the payloads
+ *        which hold memory on the heap and can not be changed.
+ */
+template <class T, class Enable = void>
+struct ByteSize {
+  static size_t get(const T& data) { return sizeof(T); }
+};
+
+template <class T>
+struct ByteSize<T, typename std::enable_if<HasByteSize<T>::value>::type> {
+  static size_t get(const T& data) { return data.byte_size(); }
+};
+
+/**
+ * @brief How a cache charges a payload to its bytes. Each cache charges the bytes of
+ *        the payloads it holds by default. Specialize it for the payloads held by
+ *        several caches at once, which should be counted once.
+ */
+template <class T, class Enable = void>
+struct ByteCharge {
+  /**
+   * @brief the cache starts holding the data
+   * @param [in] the data
+   * @param [in] the bytes of the data, see ByteSize
+   * @param [in] the bytes of the cache
+   */
+  static void charge(const T& data, size_t bytes, std::atomic<size_t>* account) {
+    *account += bytes;
+  }
+
+  /**
+   * @brief the cache stops holding the data, with the bytes given to charge
+   */
+  static void discharge(const T& data, size_t bytes, std::atomic<size_t>* account) {
+    *account -= bytes;
+  }
+};
+
+}  // namespace airi
+}  // namespace crdc
@@ -6,7 +6,12 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <deque>
+#include <functional>
+#include <iterator>
 #include <limits>
 #include <list>
 #include <map>
@@ -16,29 +21,84 @@
 #include <vector>
 
 #include "framework/shared_data.h"
+#include "framework/byte_size.h"
 #include "framework/frame.h"
+#include "framework/cached_ring.h"
 
 namespace crdc {
 namespace airi {
 
 DECLARE_int32(cached_data_stale_time);
 DECLARE_int32(cached_data_tolerate_offset);
+DECLARE_bool(cached_data_evict_on_put);
 
 template <class T>
 class StaticCachedData;
 template <class T>
 class DynamicCachedData;
 template <class T>
+class RingCachedData;
+template <class T>
 using SharedPtr = std::shared_ptr<T>;
+/**
+ * @brief the data in the map caches with its bytes at put time
+ */
+template <class T>
+struct CachedEntry {
+  std::shared_ptr<T> data;
+  size_t bytes;
+};
+template <class T>
+using CachedDataVisitor = std::function<void(uint64_t, const SharedPtr<const T>&)>;
+
+/**
+ * @brief find the data whose key is the nearest to the given key in a time sorted map.
+ *        lower_bound, then check both neighbors. The earlier one wins on a tie.
+ * @param [in] the time sorted data
+ * @param [in] key word
+ * @param [in] the max distance (exclusive) between the keys
+ * @param [out] the data
+ * @return is the action success[bool]
+ */
+template <class T>
+bool get_nearest(const std::map<uint64_t, CachedEntry<T>>& data, uint64_t key,
+                 uint64_t tolerate_diff, std::shared_ptr<T>* out) {
+  auto it = data.lower_bound(key);
+  bool found = false;
+  uint64_t diff = tolerate_diff;
+  if (it != data.begin()) {
+    auto prev = std::prev(it);
+    if (key - prev->first < diff) {
+      diff = key - prev->first;
+      *out = prev->second.data;
+      found = true;
+    }
+  }
+  if (it != data.end() && it->first - key < diff) {
+    *out = it->second.data;
+    found = true;
+  }
+  return found;
+}
 
 template <class T>
 class CachedDataBase : public SharedData {
  public:
-  CachedDataBase() : SharedData() { stale_time_ = FLAGS_cached_data_stale_time * 1e6; }
+  CachedDataBase() : SharedData(), bytes_(0), waiters_(0) {
+    stale_time_ = FLAGS_cached_data_stale_time * 1e6;
+  }
   virtual ~CachedDataBase() = default;
 
   bool init() override { return true; }
 
+  size_t size() const override { return bytes_.load(std::memory_order_relaxed); }
+
+  const SharedDataStatus stat() const override {
+    SharedDataStatus stat = this->stat_;
+    stat.counter_get += newest_gets_.load(std::memory_order_relaxed);
+    return stat;
+  }
+
   /**
    * @brief get the frequency
    */
@@ -77,6 +137,37 @@ class CachedDataBase : public SharedData {
    */
   virtual bool get_newest(SharedPtr<const T>* data) const = 0;
 
+  /**
+   * @brief get the data in the cache by key in tolerate, wait until it is put
+   *        if it is not in the cache yet. put wakes the waiters.
+   * @param [in]key word
+   * @param [out] the data
+   * @param [in] tolerete time
+   * @param [in] the max time to wait in usec
+   * @return is the action success[bool]
+   */
+  virtual bool wait_for(uint64_t key, SharedPtr<T>* data, int tolerate,
+                        uint64_t timeout_us) const {
+    if (get(key, data, tolerate)) {
+      return true;
+    }
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+    std::unique_lock<std::mutex> lock(wait_lock_);
+    waiters_.fetch_add(1);
+    // pairs with the fence in notify_put, the put is seen or the waiter is seen
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool found = false;
+    while (!(found = get(key, data, tolerate))) {
+      if (wait_cv_.wait_until(lock, deadline) == std::cv_status::timeout) {
+        found = get(key, data, tolerate);
+        break;
+      }
+    }
+    waiters_.fetch_sub(1);
+    return found;
+  }
+
   /**
    * @brief get the data in the cache byfrom and to
    * @param [in]from key
@@ -86,22 +177,96 @@ class CachedDataBase : public SharedData {
    */
   virtual bool get(uint64_t from, uint64_t to, std::vector<SharedPtr<const T>>* data) const = 0;
 
+  /**
+   * @brief visit the data whose key is in (from, to] in time order, without
+   *        building a vector. The map caches call fn under the cache lock,
+   *        so fn should be short and must not access the same cache.
+   * @param [in]from key
+   * @param [in]to key
+   * @param [in] the visitor, called with the key and the data
+   * @return is the action success[bool]
+   */
+  virtual bool for_each_in_range(uint64_t from, uint64_t to,
+                                 const CachedDataVisitor<T>& fn) const = 0;
+
   /**
    * @brief put the data in the cache
    */
   virtual bool put(uint64_t key, const std::shared_ptr<T>& data) = 0;
   virtual bool put(uint64_t key, const T& data) = 0;
 
+  /**
+   * @brief replace the data of an existing key, used when a consumer writes its
+   *        own copy of a shared data back to the cache.
+   * @return false if the key is not in the cache
+   */
+  virtual bool replace(uint64_t key, const std::shared_ptr<T>& data) = 0;
+
  protected:
+  static size_t byte_size(const std::shared_ptr<T>& data) {
+    return data ? ByteSize<T>::get(*data) : 0;
+  }
+
+  /**
+   * @brief charge the data held by the cache to bytes_, see ByteCharge
+   */
+  void charge(const std::shared_ptr<T>& data, size_t bytes) {
+    if (data) {
+      ByteCharge<T>::charge(*data, bytes, &bytes_);
+    }
+  }
+
+  /**
+   * @brief the cache stops holding the data charged with the bytes
+   */
+  void discharge(const std::shared_ptr<T>& data, size_t bytes) {
+    if (data) {
+      ByteCharge<T>::discharge(*data, bytes, &bytes_);
+    }
+  }
+
+  /**
+   * @brief count a get_newest in the get counter. It takes no lock, so it is not
+   *        counted in stat_.
+   */
+  void count_newest_get() const { newest_gets_.fetch_add(1, std::memory_order_relaxed); }
+
+  /**
+   * @brief wake the waiters of wait_for, called after the data is put.
+   *        Nearly free when nobody waits.
+   */
+  void notify_put() const {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) > 0) {
+      std::unique_lock<std::mutex> lock(wait_lock_);
+      wait_cv_.notify_all();
+    }
+  }
+
   uint64_t stale_time_;
+  // the bytes of the data held, see ByteSize
+  std::atomic<size_t> bytes_;
+  // the get_newest calls, see count_newest_get
+  mutable std::atomic<uint64_t> newest_gets_{0};
+
+ private:
+  mutable std::mutex wait_lock_;
+  mutable std::condition_variable wait_cv_;
+  mutable std::atomic<int> waiters_;
 };
 
 template <class T>
 class CachedData : public CachedDataBase<T> {
  public:
   CachedData() : CachedDataBase<T>() {}
-  explicit CachedData(int hz) : CachedData() {
-    if (hz > 0) {
+  explicit CachedData(int hz, OperatorOutput::CacheBackend backend = OperatorOutput::MAP)
+      : CachedData() {
+    if (backend == OperatorOutput::RING && hz <= 0) {
+      LOG(WARNING) << "CachedData: RING backend needs hz > 0, use MAP instead";
+    }
+    if (hz > 0 && backend == OperatorOutput::RING) {
+      impl_.reset(new RingCachedData<T>(hz));
+    } else if (hz > 0) {
       impl_.reset(new StaticCachedData<T>(hz));
     } else {
       impl_.reset(new DynamicCachedData<T>());
@@ -112,6 +277,20 @@ class CachedData : public CachedDataBase<T> {
   size_t hz() const override { return impl_->hz(); }
   size_t uperiod() const override { return impl_->uperiod(); }
   size_t size() const override { return impl_->size(); }
+  size_t count() const override { return impl_->count(); }
+
+  const SharedDataStatus stat() const override {
+    SharedDataStatus stat = impl_->stat();
+    stat.counter_get += this->stat_.counter_get;
+    return stat;
+  }
+
+  void set_byte_budget(size_t bytes) override {
+    SharedData::set_byte_budget(bytes);
+    impl_->set_byte_budget(bytes);
+  }
+
+  size_t evict_oldest() override { return impl_->evict_oldest(); }
 
   void set_key(const std::string& key) override {
     SharedData::set_key(key);
@@ -134,6 +313,11 @@ class CachedData : public CachedDataBase<T> {
     return true;
   }
 
+  bool wait_for(uint64_t key, SharedPtr<T>* data, int tolerate,
+                uint64_t timeout_us) const override {
+    return impl_->wait_for(key, data, tolerate, timeout_us);
+  }
+
   bool get_newest(SharedPtr<const T>* data) const override {
     if (!impl_->get_newest(data)) {
       // LOG_EVERY_N(ERROR, 100) << "Failed to get_newest [" << this->key() << "]";
@@ -157,6 +341,20 @@ class CachedData : public CachedDataBase<T> {
     return true;
   }
 
+  bool for_each_in_range(uint64_t from, uint64_t to,
+                         const CachedDataVisitor<T>& fn) const override {
+    if (to <= from) {
+      LOG(ERROR) << "Failed to visit [" << this->key() << "]: from >= to ("
+                 << from << " >= " << to << ")";
+      return false;
+    }
+    if (!impl_->for_each_in_range(from, to, fn)) {
+      LOG(ERROR) << "Failed to visit [" << this->key() << "]";
+      return false;
+    }
+    return true;
+  }
+
   bool put(uint64_t key, const std::shared_ptr<T>& data) override {
     if (!impl_->put(key, data)) {
       return false;
@@ -170,6 +368,10 @@ class CachedData : public CachedDataBase<T> {
     return true;
   }
 
+  bool replace(uint64_t key, const std::shared_ptr<T>& data) override {
+    return impl_->replace(key, data);
+  }
+
   void publish(const uint64_t& timestamp, const Event* sub_event,
                const std::vector<EventMeta>& pub_events,
                const std::vector<int>* processed = nullptr) {
@@ -215,15 +417,15 @@ class CachedData : public CachedDataBase<T> {
 template <class T>
 class DynamicCachedData : public CachedDataBase<T> {
  public:
-  DynamicCachedData() : CachedDataBase<T>(), hz_(0), last_(0), latest_(0) {}
+  DynamicCachedData()
+      : CachedDataBase<T>(), hz_(0), last_(0), latest_(0), newest_(newest_slots_) {}
+
+  virtual ~DynamicCachedData() { reset(); }
 
   size_t hz() const override {
     std::unique_lock<std::mutex> lock(lock_);
-    uint64_t slot = last_ / slot_size_;
-    if (data_.find(slot) == data_.end()) {
-      return 0;
-    }
-    return data_.at(slot).size();
+    uint64_t begin = last_ / slot_size_ * slot_size_;
+    return std::distance(data_.lower_bound(begin), data_.lower_bound(begin + slot_size_));
   }
   size_t uperiod() const override {
     size_t hz = this->hz();
@@ -233,18 +435,18 @@ class DynamicCachedData : public CachedDataBase<T> {
     return slot_size_ / this->hz();
   }
 
-  size_t size() const override {
-    int size = 0;
+  size_t count() const override {
     std::unique_lock<std::mutex> lock(lock_);
-    for (auto& p : data_) {
-      size += p.second.size();
-    }
-    return size * sizeof(T);
+    return data_.size();
   }
 
   void reset() override {
     std::unique_lock<std::mutex> lock(lock_);
+    for (auto& p : data_) {
+      this->discharge(p.second.data, p.second.bytes);
+    }
     data_.clear();
+    newest_.clear();
   }
 
   std::string name() const override { return "DynamicCachedData"; }
@@ -252,77 +454,73 @@ class DynamicCachedData : public CachedDataBase<T> {
   bool get(uint64_t key, std::shared_ptr<T>* data,
            int tolerate = FLAGS_cached_data_tolerate_offset) const override {
     std::unique_lock<std::mutex> lock(lock_);
-    uint64_t slot = key / slot_size_;
-    if (data_.find(slot) != data_.end() && data_.at(slot).find(key) != data_.at(slot).end()) {
-      *data = data_.at(slot).at(key);
+    auto it = data_.find(key);
+    if (it != data_.end()) {
+      *data = it->second.data;
       return true;
     }
     bool found = false;
     if (tolerate > 0) {
-      uint64_t tolerate_diff = 1000 * tolerate;
-      uint64_t diff = std::numeric_limits<uint64_t>::max();
-      for (uint64_t s = slot - 1; s < slot + 2; ++s) {
-        if (data_.find(s) == data_.end()) {
-          continue;
-        }
-        for (auto& p : data_.at(s)) {
-          uint64_t dt = (key > p.first ? key - p.first : p.first - key);
-          if (dt < diff && dt < tolerate_diff) {
-            diff = dt;
-            found = true;
-            *data = data_.at(s).at(p.first);
-          }
-        }
-      }
+      found = get_nearest(data_, key, 1000 * tolerate, data);
       this->stat_.counter_get += found;
     }
     return found;
   }
 
+  // wait free, read the slot published by put.
   bool get_newest(SharedPtr<const T>* data) const override {
-    std::unique_lock<std::mutex> lock(lock_);
-    uint64_t slot = latest_ / slot_size_;
-    if (data_.find(slot) != data_.end() && data_.at(slot).find(latest_) != data_.at(slot).end()) {
-      *data = data_.at(slot).at(latest_);
-      ++this->stat_.counter_get;
-      return true;
+    uint64_t key = 0;
+    std::shared_ptr<T> newest;
+    if (!newest_.newest(&key, &newest)) {
+      return false;
     }
-    return false;
+    *data = newest;
+    this->count_newest_get();
+    return true;
   }
 
   bool get(uint64_t from, uint64_t to, std::vector<SharedPtr<const T>>* data) const override {
+    return for_each_in_range(from, to, [data](uint64_t key, const SharedPtr<const T>& d) {
+      data->emplace_back(d);
+    });
+  }
+
+  bool for_each_in_range(uint64_t from, uint64_t to,
+                         const CachedDataVisitor<T>& fn) const override {
     std::unique_lock<std::mutex> lock(lock_);
     if (data_.empty()) {
       LOG(WARNING) << this->key() << "CachedData: empty";
       return false;
     }
 
-    for (auto it = data_.begin(); it != data_.end(); ++it) {
-      const auto& s = it->second;
-      for (auto iit = s.begin(); iit != s.end(); ++iit) {
-        if (iit->first > to) {
-          goto DYN_DATA_END;
-        }
-        if (iit->first > from) {
-          data->emplace_back(iit->second);
-        }
-      }
+    for (auto it = data_.upper_bound(from); it != data_.end() && it->first <= to; ++it) {
+      fn(it->first, it->second.data);
     }
-  DYN_DATA_END:
     return true;
   }
 
   bool put(uint64_t key, const std::shared_ptr<T>& data) override {
+    size_t bytes = this->byte_size(data);
     std::unique_lock<std::mutex> lock(lock_);
-    uint64_t slot = key / slot_size_;
-    if (data_[slot].find(key) != data_[slot].end()) {
+    if (!data_.emplace(key, CachedEntry<T>{data, bytes}).second) {
       LOG(WARNING) << "CachedData: Duplicate index: " << key;
       return false;
     }
     last_ = latest_;
     latest_ = key;
-    data_[slot][key] = data;
+    newest_.keep_newest(key, data);
     ++this->stat_.counter_add;
+    this->charge(data, bytes);
+    if (FLAGS_cached_data_evict_on_put) {
+      remove_expired_locked(key);
+    }
+    // keep the newest one even if it is larger than the budget
+    size_t budget = this->byte_budget_;
+    while (budget > 0 && this->bytes_ > budget && data_.size() > 1) {
+      evict_oldest_locked();
+    }
+    lock.unlock();
+    this->notify_put();
     return true;
   }
   bool put(uint64_t key, const T& data) override {
@@ -330,39 +528,88 @@ class DynamicCachedData : public CachedDataBase<T> {
     return put(key, ptr);
   }
 
+  bool replace(uint64_t key, const std::shared_ptr<T>& data) override {
+    size_t bytes = this->byte_size(data);
+    std::unique_lock<std::mutex> lock(lock_);
+    auto it = data_.find(key);
+    if (it == data_.end()) {
+      return false;
+    }
+    this->charge(data, bytes);
+    this->discharge(it->second.data, it->second.bytes);
+    it->second = CachedEntry<T>{data, bytes};
+    if (key == latest_) {
+      newest_.keep_newest(key, data);
+    }
+    return true;
+  }
+
   void remove_stale_data(const uint64_t& stale_time) override {
     std::unique_lock<std::mutex> lock(lock_);
     if (latest_ < stale_time) {
       return;
     }
 
-    uint64_t k = 0;
-    if (latest_ > stale_time) {
-      k = (latest_ - stale_time) / slot_size_;
+    // keep the whole 1s slot which contains latest_ - stale_time
+    uint64_t k = (latest_ - stale_time) / slot_size_ * slot_size_;
+    auto end = data_.lower_bound(k);
+    for (auto it = data_.begin(); it != end; ++it) {
+      this->discharge(it->second.data, it->second.bytes);
+      ++this->stat_.counter_remove;
     }
-    for (auto it = data_.begin(); it != data_.end();) {
-      if (it->first < k) {
-        ++this->stat_.counter_remove;
-        it = data_.erase(it);
-      } else {
-        ++it;
-      }
+    data_.erase(data_.begin(), end);
+  }
+
+  size_t evict_oldest() override {
+    std::unique_lock<std::mutex> lock(lock_);
+    if (data_.size() <= 1) {
+      return 0;
     }
+    return evict_oldest_locked();
   }
 
  protected:
   // 1s
   static const uint64_t slot_size_ = 1000000;
+  // the newest data only, which is also in data_, so nothing is pinned out of bytes_
+  static const size_t newest_slots_ = 2;
 
  private:
   template <typename U>
   friend class CachedData;
 
+  // evict the oldest data, the lock_ should be held
+  size_t evict_oldest_locked() {
+    size_t bytes = data_.begin()->second.bytes;
+    this->discharge(data_.begin()->second.data, bytes);
+    data_.erase(data_.begin());
+    ++this->stat_.counter_evict;
+    return bytes;
+  }
+
+  // remove the data older than key - stale_time_ from the oldest one, O(expired).
+  // the lock_ should be held
+  void remove_expired_locked(uint64_t key) {
+    if (key <= this->stale_time_) {
+      return;
+    }
+    const uint64_t expire = key - this->stale_time_;
+    while (!data_.empty() && data_.begin()->first < expire) {
+      this->discharge(data_.begin()->second.data, data_.begin()->second.bytes);
+      ++this->stat_.counter_remove;
+      data_.erase(data_.begin());
+    }
+  }
+
   size_t hz_;
   uint64_t last_;
   uint64_t latest_;
   mutable std::mutex lock_;
-  std::map<uint64_t, std::map<uint64_t, std::shared_ptr<T>>> data_;
+  // sorted by the timestamp
+  std::map<uint64_t, CachedEntry<T>> data_;
+  // the latest put data, published for the lock free get_newest
+  CachedRing<T> newest_;
+
 };
 
 template <class T>
@@ -372,106 +619,105 @@ class StaticCachedData : public CachedDataBase<T> {
       : CachedDataBase<T>(),
         hz_(hz),
         offset_(1e6 / hz),
-        half_peroid_(5e5 / hz) {
+        half_peroid_(5e5 / hz),
+        last_(0),
+        latest_(0),
+        newest_(newest_slots_) {
     data_.clear();
   }
 
-  virtual ~StaticCachedData() = default;
+  virtual ~StaticCachedData() { reset(); }
 
   size_t hz() const override { return hz_; }
   size_t uperiod() const override { return offset_; }
 
   std::string name() const override { return "StaticCachedData@" + std::to_string(hz_); }
 
-  size_t size() const override {
-    int size = 0;
+  size_t count() const override {
     std::unique_lock<std::mutex> lock(lock_);
-    for (auto& p : data_) {
-      size += p.second.size();
-    }
-    return size * sizeof(T);
+    return data_.size();
   }
 
   void reset() override {
     std::unique_lock<std::mutex> lock(lock_);
+    for (auto& p : data_) {
+      this->discharge(p.second.data, p.second.bytes);
+    }
     data_.clear();
+    newest_.clear();
   }
 
   bool get(uint64_t key, std::shared_ptr<T>* data,
            int tolerate = FLAGS_cached_data_tolerate_offset) const override {
     std::unique_lock<std::mutex> lock(lock_);
-    uint64_t slot = key / slot_size_;
-    if (data_.find(slot) != data_.end() && data_.at(slot).find(key) != data_.at(slot).end()) {
-      *data = data_.at(slot).at(key);
+    auto it = data_.find(key);
+    if (it != data_.end()) {
+      *data = it->second.data;
       return true;
     }
 
     bool found = false;
     if (tolerate > 0) {
-      uint64_t tolerate_diff = offset_ * tolerate;
-      uint64_t diff = std::numeric_limits<uint64_t>::max();
-      for (uint64_t s = slot - 1; s < slot + 2; ++s) {
-        if (data_.find(s) == data_.end()) {
-          continue;
-        }
-        for (auto& p : data_.at(s)) {
-          uint64_t dt = (key > p.first ? key - p.first : p.first - key);
-          if (dt < diff && dt < tolerate_diff) {
-            diff = dt;
-            found = true;
-            *data = data_.at(s).at(p.first);
-          }
-        }
-      }
+      found = get_nearest(data_, key, offset_ * tolerate, data);
       this->stat_.counter_get += found;
     }
     return found;
   }
 
+  // wait free, read the slot published by put.
   bool get_newest(SharedPtr<const T>* data) const override {
-    std::unique_lock<std::mutex> lock(lock_);
-    uint64_t slot = latest_ / slot_size_;
-    if (data_.find(slot) != data_.end() && data_.at(slot).find(latest_) != data_.at(slot).end()) {
-      *data = data_.at(slot).at(latest_);
-      ++this->stat_.counter_get;
-      return true;
+    uint64_t key = 0;
+    std::shared_ptr<T> newest;
+    if (!newest_.newest(&key, &newest)) {
+      return false;
     }
-    return false;
+    *data = newest;
+    this->count_newest_get();
+    return true;
   }
 
   bool get(uint64_t from, uint64_t to, std::vector<SharedPtr<const T>>* data) const override {
+    return for_each_in_range(from, to, [data](uint64_t key, const SharedPtr<const T>& d) {
+      data->emplace_back(d);
+    });
+  }
+
+  bool for_each_in_range(uint64_t from, uint64_t to,
+                         const CachedDataVisitor<T>& fn) const override {
     std::unique_lock<std::mutex> lock(lock_);
     if (data_.empty()) {
       LOG(WARNING) << this->key() << "CachedData: empty";
       return false;
     }
 
-    for (auto it = data_.begin(); it != data_.end(); ++it) {
-      const auto& s = it->second;
-      for (auto iit = s.begin(); iit != s.end(); ++iit) {
-        if (iit->first > to) {
-          goto DYN_DATA_END;
-        }
-        if (iit->first > from) {
-          data->emplace_back(iit->second);
-        }
-      }
+    for (auto it = data_.upper_bound(from); it != data_.end() && it->first <= to; ++it) {
+      fn(it->first, it->second.data);
     }
-    DYN_DATA_END:
     return true;
   }
 
   bool put(uint64_t key, const std::shared_ptr<T>& data) override {
+    size_t bytes = this->byte_size(data);
     std::unique_lock<std::mutex> lock(lock_);
-    uint64_t slot = key / slot_size_;
-    if (data_[slot].find(key) != data_[slot].end()) {
+    if (!data_.emplace(key, CachedEntry<T>{data, bytes}).second) {
       LOG(WARNING) << "CachedData: Duplicate index: " << key;
       return false;
     }
     last_ = latest_;
     latest_ = key;
-    data_[slot][key] = data;
+    newest_.keep_newest(key, data);
     ++this->stat_.counter_add;
+    this->charge(data, bytes);
+    if (FLAGS_cached_data_evict_on_put) {
+      remove_expired_locked(key);
+    }
+    // keep the newest one even if it is larger than the budget
+    size_t budget = this->byte_budget_;
+    while (budget > 0 && this->bytes_ > budget && data_.size() > 1) {
+      evict_oldest_locked();
+    }
+    lock.unlock();
+    this->notify_put();
     return true;
   }
 
@@ -480,33 +726,78 @@ class StaticCachedData : public CachedDataBase<T> {
     return put(key, ptr);
   }
 
+  bool replace(uint64_t key, const std::shared_ptr<T>& data) override {
+    size_t bytes = this->byte_size(data);
+    std::unique_lock<std::mutex> lock(lock_);
+    auto it = data_.find(key);
+    if (it == data_.end()) {
+      return false;
+    }
+    this->charge(data, bytes);
+    this->discharge(it->second.data, it->second.bytes);
+    it->second = CachedEntry<T>{data, bytes};
+    if (key == latest_) {
+      newest_.keep_newest(key, data);
+    }
+    return true;
+  }
+
   void remove_stale_data(const uint64_t& stale_time) override {
     std::unique_lock<std::mutex> lock(lock_);
     if (latest_ < stale_time) {
       return;
     }
 
-    uint64_t k = 0;
-    if (latest_ > stale_time) {
-      k = (latest_ - stale_time) / slot_size_;
+    // keep the whole 1s slot which contains latest_ - stale_time
+    uint64_t k = (latest_ - stale_time) / slot_size_ * slot_size_;
+    auto end = data_.lower_bound(k);
+    for (auto it = data_.begin(); it != end; ++it) {
+      this->discharge(it->second.data, it->second.bytes);
+      ++this->stat_.counter_remove;
     }
-    for (auto it = data_.begin(); it != data_.end();) {
-      if (it->first < k) {
-        ++this->stat_.counter_remove;
-        it = data_.erase(it);
-      } else {
-        ++it;
-      }
+    data_.erase(data_.begin(), end);
+  }
+
+  size_t evict_oldest() override {
+    std::unique_lock<std::mutex> lock(lock_);
+    if (data_.size() <= 1) {
+      return 0;
     }
+    return evict_oldest_locked();
   }
 
  protected:
   static const uint64_t slot_size_ = 1000000;
+  // the newest data only, which is also in data_, so nothing is pinned out of bytes_
+  static const size_t newest_slots_ = 2;
 
  private:
   template <typename U>
   friend class CachedData;
 
+  // evict the oldest data, the lock_ should be held
+  size_t evict_oldest_locked() {
+    size_t bytes = data_.begin()->second.bytes;
+    this->discharge(data_.begin()->second.data, bytes);
+    data_.erase(data_.begin());
+    ++this->stat_.counter_evict;
+    return bytes;
+  }
+
+  // remove the data older than key - stale_time_ from the oldest one, O(expired).
+  // the lock_ should be held
+  void remove_expired_locked(uint64_t key) {
+    if (key <= this->stale_time_) {
+      return;
+    }
+    const uint64_t expire = key - this->stale_time_;
+    while (!data_.empty() && data_.begin()->first < expire) {
+      this->discharge(data_.begin()->second.data, data_.begin()->second.bytes);
+      ++this->stat_.counter_remove;
+      data_.erase(data_.begin());
+    }
+  }
+
   size_t hz_;
   size_t offset_;
   size_t half_peroid_;
@@ -514,13 +805,146 @@ class StaticCachedData : public CachedDataBase<T> {
   uint64_t latest_;
 
   mutable std::mutex lock_;
-  std::map<uint64_t, std::map<uint64_t, std::shared_ptr<T>>> data_;
+  // sorted by the timestamp
+  std::map<uint64_t, CachedEntry<T>> data_;
+  // the latest put data, published for the lock free get_newest
+  CachedRing<T> newest_;
+
   DISALLOW_COPY_AND_ASSIGN(StaticCachedData);
 };
 
+/**
+ * @brief The StaticCachedData with a lock free ring as storage.
+ *        The capacity is hz * cached_data_stale_time. put() rejects a key not
+ *        newer than the newest one under the write guard of the ring, so more than
+ *        one producer is safe. The getters take no lock, replace() could be called
+ *        by any thread.
+ */
+template <class T>
+class RingCachedData : public CachedDataBase<T> {
+ public:
+  explicit RingCachedData(size_t hz)
+      : CachedDataBase<T>(),
+        hz_(hz),
+        offset_(1e6 / hz),
+        ring_(std::max<size_t>(hz * FLAGS_cached_data_stale_time, 2)) {}
+
+  virtual ~RingCachedData() { reset(); }
+
+  size_t hz() const override { return hz_; }
+  size_t uperiod() const override { return offset_; }
+
+  std::string name() const override { return "RingCachedData@" + std::to_string(hz_); }
+
+  size_t count() const override { return ring_.count(); }
+
+  void reset() override {
+    std::shared_ptr<T> dropped;
+    while (ring_.count() > 0) {
+      size_t bytes = ring_.pop(&dropped);
+      this->discharge(dropped, bytes);
+    }
+  }
+
+  // the get counter is not maintained, to keep the readers off shared cache lines.
+  bool get(uint64_t key, std::shared_ptr<T>* data,
+           int tolerate = FLAGS_cached_data_tolerate_offset) const override {
+    uint64_t tolerate_diff = tolerate > 0 ? offset_ * tolerate : 0;
+    return ring_.find(key, tolerate_diff, data);
+  }
+
+  bool get_newest(SharedPtr<const T>* data) const override {
+    uint64_t key = 0;
+    std::shared_ptr<T> newest;
+    if (!ring_.newest(&key, &newest)) {
+      return false;
+    }
+    *data = newest;
+    this->count_newest_get();
+    return true;
+  }
+
+  bool get(uint64_t from, uint64_t to, std::vector<SharedPtr<const T>>* data) const override {
+    return for_each_in_range(from, to, [data](uint64_t key, const SharedPtr<const T>& d) {
+      data->emplace_back(d);
+    });
+  }
+
+  bool for_each_in_range(uint64_t from, uint64_t to,
+                         const CachedDataVisitor<T>& fn) const override {
+    if (ring_.count() == 0) {
+      LOG(WARNING) << this->key() << "CachedData: empty";
+      return false;
+    }
+    ring_.for_each(from, to, [&fn](uint64_t key, const std::shared_ptr<T>& d) {
+      fn(key, d);
+    });
+    return true;
+  }
+
+  bool put(uint64_t key, const std::shared_ptr<T>& data) override {
+    size_t bytes = this->byte_size(data);
+    std::shared_ptr<T> evicted;
+    size_t evicted_bytes = 0;
+    // charged before it is visible, another producer may evict it right away
+    this->charge(data, bytes);
+    if (!ring_.push_newer(key, data, bytes, &evicted_bytes, &evicted)) {
+      this->discharge(data, bytes);
+      LOG(WARNING) << "CachedData: Duplicate or out of order index: " << key
+                   << " newest: " << ring_.newest_key();
+      return false;
+    }
+    this->discharge(evicted, evicted_bytes);
+    ++this->stat_.counter_add;
+    size_t budget = this->byte_budget_;
+    while (budget > 0 && this->bytes_ > budget && ring_.count() > 1) {
+      evicted_bytes = ring_.pop(&evicted);
+      this->discharge(evicted, evicted_bytes);
+      ++this->stat_.counter_evict;
+    }
+    this->notify_put();
+    return true;
+  }
+
+  bool put(uint64_t key, const T& data) override {
+    std::shared_ptr<T> ptr = std::make_shared<T>(data);
+    return put(key, ptr);
+  }
+
+  bool replace(uint64_t key, const std::shared_ptr<T>& data) override {
+    size_t bytes = this->byte_size(data);
+    size_t old_bytes = 0;
+    std::shared_ptr<T> old;
+    this->charge(data, bytes);
+    if (!ring_.replace(key, data, bytes, &old_bytes, &old)) {
+      this->discharge(data, bytes);
+      return false;
+    }
+    this->discharge(old, old_bytes);
+    return true;
+  }
+
+  // the ring is bounded by the stale time, and only put could evict.
+  void remove_stale_data(const uint64_t& stale_time) override {}
+
+  // the byte budget of the ring is applied in put.
+  size_t evict_oldest() override { return 0; }
+
+ private:
+  template <typename U>
+  friend class CachedData;
+
+  size_t hz_;
+  size_t offset_;
+  CachedRing<T> ring_;
+  DISALLOW_COPY_AND_ASSIGN(RingCachedData);
+};
+
 class FrameCachedData : public CachedData<Frame> {
  public:
-  explicit FrameCachedData(size_t hz) : CachedData<Frame>(hz) {}
+  explicit FrameCachedData(size_t hz,
+                           OperatorOutput::CacheBackend backend = OperatorOutput::MAP)
+      : CachedData<Frame>(hz, backend) {}
   virtual ~FrameCachedData() = default;
 
   std::string name() const override { return "FrameCachedData@" + std::to_string(hz()); }
@@ -0,0 +1,449 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: cached ring. A fixed capacity ring of timestamped data with a single
+//              producer and lock free readers. It is the storage of RingCachedData.
+//              The rare replace() from another thread is serialized with the producer
+//              by a spin flag, which is never taken by the readers. push_newer() checks
+//              the key under the same flag, so it could have more than one producer. The readers validate
+//              a seqlock and protect the data they copy by a hazard record of their own.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include "common/macros.h"
+
+namespace crdc {
+namespace airi {
+
+/**
+ * @brief The hazard records of the reader threads, one cache line each. A reader
+ *        publishes the slot it copies the shared_ptr from in its own record, and the
+ *        producer waits for the records before it releases the data of the slot, so
+ *        the readers never write a line shared with the other readers.
+ */
+class HazardRecords {
+ public:
+  static const int kMaxRecords = 256;
+
+  struct alignas(64) Record {
+    std::atomic<const void*> ptr{nullptr};
+    std::atomic<bool> used{false};
+  };
+
+  /**
+   * @brief the record of the current thread, nullptr if all are taken
+   */
+  static Record* local() {
+    static thread_local Owner owner;
+    return owner.record;
+  }
+
+  /**
+   * @brief whether a reader is copying from the pointer
+   */
+  static bool is_protected(const void* ptr) {
+    // seq_cst as the hazard, a record taken before the hazard store is scanned
+    const int size = high_water().load(std::memory_order_seq_cst);
+    Record* records = table();
+    for (int i = 0; i < size; ++i) {
+      if (records[i].ptr.load(std::memory_order_seq_cst) == ptr) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  // takes a record for the thread and gives it back when the thread exits
+  struct Owner {
+    Owner() {
+      Record* records = table();
+      for (int i = 0; i < kMaxRecords; ++i) {
+        bool used = false;
+        if (records[i].used.compare_exchange_strong(used, true)) {
+          record = &records[i];
+          int size = high_water().load(std::memory_order_relaxed);
+          while (size < i + 1 && !high_water().compare_exchange_weak(size, i + 1)) {
+          }
+          return;
+        }
+      }
+    }
+    ~Owner() {
+      if (record) {
+        record->ptr.store(nullptr, std::memory_order_release);
+        record->used.store(false, std::memory_order_release);
+      }
+    }
+    Record* record = nullptr;
+  };
+
+  static Record* table() {
+    static Record records[kMaxRecords];
+    return records;
+  }
+  static std::atomic<int>& high_water() {
+    static std::atomic<int> size{0};
+    return size;
+  }
+};
+
+template <class T>
+class CachedRing {
+ public:
+  /**
+   * @brief create the ring, the capacity is rounded up to the power of 2
+   * @param [in] the minimum capacity
+   */
+  explicit CachedRing(size_t capacity) : capacity_(2) {
+    while (capacity_ < capacity) {
+      capacity_ <<= 1;
+    }
+    mask_ = capacity_ - 1;
+    slots_.reset(new Slot[capacity_]);
+  }
+
+  size_t capacity() const { return capacity_; }
+
+  /**
+   * @brief the number of valid data in the ring
+   */
+  size_t count() const {
+    uint64_t tail = tail_.load(std::memory_order_acquire);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    return head > tail ? head - tail : 0;
+  }
+
+  /**
+   * @brief the key of the newest data, 0 if the ring is empty
+   */
+  uint64_t newest_key() const { return newest_key_.load(std::memory_order_acquire); }
+
+  /**
+   * @brief append the data, the oldest one is evicted when the ring is full.
+   *        producer only. find() needs the keys to be strictly increasing.
+   * @param [in] key
+   * @param [in] the data
+   * @param [in] the bytes of the data, kept for the producer
+   * @param [out] the evicted data if not nullptr
+   * @return the bytes of the evicted data, 0 if nothing is evicted
+   */
+  size_t push(uint64_t key, const std::shared_ptr<T>& data, size_t bytes = 0,
+              std::shared_ptr<T>* evicted_data = nullptr) {
+    WriteGuard guard(&writing_);
+    return push_locked(key, data, bytes, evicted_data);
+  }
+
+  /**
+   * @brief append the data if the key is newer than the newest one. The key is
+   *        checked under the guard of the insert, so it is safe with more than
+   *        one producer.
+   * @param [in] key
+   * @param [in] the data
+   * @param [in] the bytes of the data
+   * @param [out] the bytes of the evicted data, 0 if nothing is evicted
+   * @param [out] the evicted data if not nullptr
+   * @return false if the ring is not empty and the key is not newer
+   */
+  bool push_newer(uint64_t key, const std::shared_ptr<T>& data, size_t bytes,
+                  size_t* evicted_bytes, std::shared_ptr<T>* evicted_data = nullptr) {
+    WriteGuard guard(&writing_);
+    if (head_.load(std::memory_order_relaxed) > tail_.load(std::memory_order_relaxed) &&
+        key <= newest_key_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    *evicted_bytes = push_locked(key, data, bytes, evicted_data);
+    return true;
+  }
+
+  /**
+   * @brief append the data and drop the older ones, so the ring only keeps the
+   *        newest. producer only.
+   */
+  void keep_newest(uint64_t key, const std::shared_ptr<T>& data) {
+    push(key, data);
+    while (count() > 1) {
+      pop();
+    }
+  }
+
+  /**
+   * @brief drop the oldest data. producer only.
+   * @param [out] the dropped data if not nullptr
+   * @return the bytes of the dropped data
+   */
+  size_t pop(std::shared_ptr<T>* dropped = nullptr) {
+    WriteGuard guard(&writing_);
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (head == tail) {
+      return 0;
+    }
+    size_t bytes = slots_[tail & mask_].bytes;
+    if (dropped) {
+      *dropped = slots_[tail & mask_].data;
+    }
+    tail_.store(tail + 1, std::memory_order_release);
+    write(tail, 0, nullptr);
+    slots_[tail & mask_].bytes = 0;
+    return bytes;
+  }
+
+  /**
+   * @brief drop all the data. producer only.
+   */
+  void clear() {
+    WriteGuard guard(&writing_);
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    tail_.store(head, std::memory_order_release);
+    for (uint64_t pos = tail; pos < head; ++pos) {
+      write(pos, 0, nullptr);
+      slots_[pos & mask_].bytes = 0;
+    }
+  }
+
+  /**
+   * @brief replace the data of the key, could be called by any thread.
+   * @param [in] key
+   * @param [in] the new data
+   * @param [in] the bytes of the new data
+   * @param [out] the bytes of the replaced data
+   * @param [out] the replaced data if not nullptr
+   * @return false if the key is not in the ring
+   */
+  bool replace(uint64_t key, const std::shared_ptr<T>& data, size_t bytes, size_t* old_bytes,
+               std::shared_ptr<T>* old_data = nullptr) {
+    WriteGuard guard(&writing_);
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t pos = lower_bound(tail, head, key);
+    if (pos == head || slots_[pos & mask_].key.load(std::memory_order_relaxed) != key) {
+      return false;
+    }
+    *old_bytes = slots_[pos & mask_].bytes;
+    if (old_data) {
+      *old_data = slots_[pos & mask_].data;
+    }
+    write(pos, key, data);
+    slots_[pos & mask_].bytes = bytes;
+    return true;
+  }
+
+  /**
+   * @brief get the newest data. wait free.
+   */
+  bool newest(uint64_t* key, std::shared_ptr<T>* data) const {
+    // the tail first, a head read before a pop could be behind it
+    uint64_t tail = tail_.load(std::memory_order_acquire);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (head <= tail) {
+      return false;
+    }
+    return load(head - 1, key, data);
+  }
+
+  /**
+   * @brief get the data whose key is the nearest to the given key.
+   *        Binary search on the keys, then check both neighbors.
+   * @param [in] key
+   * @param [in] the max distance (exclusive) between the keys, 0 for exact match
+   * @param [out] the data
+   */
+  bool find(uint64_t key, uint64_t tolerate_diff, std::shared_ptr<T>* data) const {
+    uint64_t tail = tail_.load(std::memory_order_acquire);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (head <= tail) {
+      return false;
+    }
+    uint64_t lo = lower_bound(tail, head, key);
+    bool found = false;
+    uint64_t diff = tolerate_diff;
+    uint64_t k = 0;
+    std::shared_ptr<T> d;
+    // check the earlier neighbor first, so it wins when the distances are equal
+    if (lo > tail && load(lo - 1, &k, &d)) {
+      uint64_t dt = key > k ? key - k : k - key;
+      if (dt == 0 || dt < diff) {
+        diff = dt;
+        *data = d;
+        found = true;
+      }
+    }
+    if (lo < head && load(lo, &k, &d)) {
+      uint64_t dt = key > k ? key - k : k - key;
+      if ((dt == 0 && !found) || dt < diff) {
+        *data = d;
+        found = true;
+      }
+    }
+    return found;
+  }
+
+  /**
+   * @brief visit the data whose key is in (from, to] in time order.
+   *        Binary search for the first key after from.
+   */
+  template <typename F>
+  void for_each(uint64_t from, uint64_t to, F fn) const {
+    uint64_t tail = tail_.load(std::memory_order_acquire);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (head <= tail) {
+      return;
+    }
+    uint64_t k = 0;
+    std::shared_ptr<T> d;
+    uint64_t begin = from == UINT64_MAX ? head : lower_bound(tail, head, from + 1);
+    for (uint64_t pos = begin; pos < head; ++pos) {
+      if (!load(pos, &k, &d) || k <= from) {
+        continue;
+      }
+      if (k > to) {
+        break;
+      }
+      fn(k, d);
+    }
+  }
+
+ private:
+  class WriteGuard {
+   public:
+    explicit WriteGuard(std::atomic_flag* flag) : flag_(flag) {
+      while (flag_->test_and_set(std::memory_order_acquire)) {
+      }
+    }
+    ~WriteGuard() { flag_->clear(std::memory_order_release); }
+
+   private:
+    std::atomic_flag* flag_;
+  };
+
+  struct alignas(64) Slot {
+    ALIGNED_NEW(64);
+    // odd while the producer is writing the slot
+    std::atomic<uint64_t> seq{0};
+    // the ring position and the key stored in the slot
+    std::atomic<uint64_t> pos{UINT64_MAX};
+    std::atomic<uint64_t> key{0};
+    std::shared_ptr<T> data;
+    // the bytes of the data, only touched by the producer
+    size_t bytes = 0;
+  };
+
+  /**
+   * @brief the first position in [tail, head) whose key >= key. The slots may be
+   *        overwritten meanwhile, load() checks the position afterwards.
+   */
+  uint64_t lower_bound(uint64_t tail, uint64_t head, uint64_t key) const {
+    uint64_t lo = tail;
+    uint64_t hi = head;
+    while (lo < hi) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      if (slots_[mid & mask_].key.load(std::memory_order_relaxed) < key) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  // append the data, the guard should be held
+  size_t push_locked(uint64_t key, const std::shared_ptr<T>& data, size_t bytes,
+                     std::shared_ptr<T>* evicted_data) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    size_t evicted = 0;
+    if (head - tail >= capacity_) {
+      evicted = slots_[tail & mask_].bytes;
+      if (evicted_data) {
+        *evicted_data = slots_[tail & mask_].data;
+      }
+      tail_.store(tail + 1, std::memory_order_release);
+    }
+    write(head, key, data);
+    slots_[head & mask_].bytes = bytes;
+    newest_key_.store(key, std::memory_order_release);
+    head_.store(head + 1, std::memory_order_release);
+    return evicted;
+  }
+
+  /**
+   * @brief Producer side. Mark the slot as being written and wait for the readers
+   *        which are copying the old data. The readers never wait for the producer.
+   */
+  void write(uint64_t pos, uint64_t key, const std::shared_ptr<T>& data) {
+    Slot& slot = slots_[pos & mask_];
+    uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+    // pairs with the hazard store then the seq load of load(), either the reader
+    // sees the odd seq or it is seen copying here
+    slot.seq.store(seq + 1, std::memory_order_seq_cst);
+    for (int spin = 0; HazardRecords::is_protected(&slot); ++spin) {
+      if (spin >= kSpinCount) {
+        std::this_thread::yield();
+      }
+    }
+    slot.data = data;
+    slot.key.store(key, std::memory_order_relaxed);
+    // a released slot never matches a position
+    slot.pos.store(data ? pos : UINT64_MAX, std::memory_order_relaxed);
+    slot.seq.store(seq + 2, std::memory_order_release);
+  }
+
+  /**
+   * @brief Reader side. Copy the data if the slot still holds the position. The seq
+   *        is validated before and after the hazard is published, the reader only
+   *        writes its own hazard record.
+   */
+  bool load(uint64_t pos, uint64_t* key, std::shared_ptr<T>* data) const {
+    Slot& slot = slots_[pos & mask_];
+    uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    if ((seq & 1) || slot.pos.load(std::memory_order_relaxed) != pos) {
+      return false;
+    }
+    HazardRecords::Record* hazard = HazardRecords::local();
+    if (!hazard) {
+      // more reader threads than the records, copy under the flag of the producer
+      WriteGuard guard(&writing_);
+      return load_locked(slot, pos, key, data);
+    }
+    hazard->ptr.store(&slot, std::memory_order_seq_cst);
+    bool ok = slot.seq.load(std::memory_order_seq_cst) == seq;
+    if (ok) {
+      *key = slot.key.load(std::memory_order_relaxed);
+      *data = slot.data;
+    }
+    hazard->ptr.store(nullptr, std::memory_order_release);
+    return ok;
+  }
+
+  bool load_locked(const Slot& slot, uint64_t pos, uint64_t* key,
+                   std::shared_ptr<T>* data) const {
+    if (slot.pos.load(std::memory_order_relaxed) != pos) {
+      return false;
+    }
+    *key = slot.key.load(std::memory_order_relaxed);
+    *data = slot.data;
+    return true;
+  }
+
+  static const int kSpinCount = 64;
+
+  size_t capacity_;
+  size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  // next position to write
+  std::atomic<uint64_t> head_{0};
+  // oldest valid position
+  std::atomic<uint64_t> tail_{0};
+  std::atomic<uint64_t> newest_key_{0};
+  // serializes the producer and replace()
+  mutable std::atomic_flag writing_ = ATOMIC_FLAG_INIT;
+};
+
+}  // namespace airi
+}  // namespace crdc
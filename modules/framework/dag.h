@@ -292,6 +292,12 @@ class DAG {
             if (down_output.has_hz()) {
               ds->set_hz(down_output.hz());
             }
+            if (down_output.has_cache_backend()) {
+              ds->set_cache_backend(down_output.cache_backend());
+            }
+            if (down_output.has_byte_budget_mb()) {
+              ds->set_byte_budget_mb(down_output.byte_budget_mb());
+            }
             if (!get_data_and_type_name(up.output(m), down_output, down.name(),
                                         down.trigger(n), data_name, type_name)) {
               LOG(ERROR) << "Failed to get data and type name." << down.name();
@@ -351,6 +357,78 @@ class DAG {
     return true;
   }
 
+  /**
+   * @brief whether the operator could run on the thread of its upstream, at the
+   *        priority of the upstream. The ones with an executor, a placement,
+   *        a dependency or an input to wait for keep their own thread.
+   * @param[in] the operator config
+   * @return could be fused [bool]
+   */
+  static bool can_fuse(const OperatorConfig& op) {
+    if (op.trigger_size() != 1 || op.upstream_size() != 1) {
+      return false;
+    }
+    // the custom operators may drive their own loop
+    if (op.has_type() && op.type() != "Operator") {
+      return false;
+    }
+    if (op.has_executor() || op.cpu_affinity_size() > 0 ||
+        op.isolated_cpu() || op.sched_policy() != OperatorConfig::OTHER) {
+      return false;
+    }
+    if (op.dependency_size() > 0 || op.input_wait_size() > 0 ||
+        op.trigger_queue_policy_size() > 0 || op.self_driven()) {
+      return false;
+    }
+    // the PARALLEL, PIPELINE and replicated operators run concurrently on purpose
+    if ((op.has_group() && op.group().processor() != OpGroupConfig::SEQ) ||
+        op.replicas() > 1) {
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief fuse the linear chains of the operators. When the upstream has a single
+   *        downstream over all its outputs, and that output has no reference, the
+   *        downstream runs on the thread of the upstream right after the publish
+   *        (INLINE), and the frame is handed over without the cached data between
+   *        them. The fan-out siblings keep their own threads to run concurrently,
+   *        and the input operators are never fused into.
+   * @param[in|out] the linked operator config list
+   * @return if the fusion successed[bool]
+   */
+  static bool fuse_operator(std::vector<OperatorConfig>* ops) {
+    for (size_t i = 0; i < ops->size(); ++i) {
+      auto& up = ops->at(i);
+      // the input operator keeps its thread for the source
+      if (up.upstream_size() == 0) {
+        continue;
+      }
+      int downstreams = 0;
+      OperatorOutput* up_output = nullptr;
+      for (int m = 0; m < up.output_size(); ++m) {
+        if (up.output(m).downstream_size() > 0) {
+          downstreams += up.output(m).downstream_size();
+          up_output = up.mutable_output(m);
+        }
+      }
+      if (downstreams != 1 || up_output->has_reference()) {
+        continue;
+      }
+      auto ds = up_output->mutable_downstream(0);
+      auto& down = ops->at(ds->op_id());
+      if (!can_fuse(down)) {
+        continue;
+      }
+      ds->set_fused(true);
+      down.set_fused(true);
+      down.set_executor(OperatorConfig::INLINE);
+      LOG(INFO) << "DAG: fuse " << down.name() << " into " << up.name();
+    }
+    return true;
+  }
+
   /**
    * @brief print the summary of the app dag
    * @param[in] the operator config list
@@ -380,11 +458,42 @@ class DAG {
           auto& down_op = ops[downstream.op_id()];
           auto trigger_id = downstream.trigger_id();
           ss << "        -> " << std::left << std::setw(25) << down_op.name()
-            << " [" << down_op.trigger_data(trigger_id) << "]" << std::endl;
+            << " [" << down_op.trigger_data(trigger_id) << "]"
+            << (downstream.fused() ? " (fused)" : "") << std::endl;
         }
       }
     }
 
+    // the fused chains, from the operator running on its own thread
+    bool has_fused = false;
+    for (size_t i = 0; i < ops.size(); ++i) {
+      if (ops[i].fused()) {
+        continue;
+      }
+      std::stringstream chain;
+      std::vector<int> next = {static_cast<int>(i)};
+      while (!next.empty()) {
+        int k = next.back();
+        next.pop_back();
+        chain << (k == static_cast<int>(i) ? "" : " -> ") << ops[k].name();
+        for (auto& output : ops[k].output()) {
+          for (auto& downstream : output.downstream()) {
+            if (downstream.fused()) {
+              next.emplace_back(downstream.op_id());
+            }
+          }
+        }
+      }
+      if (chain.str() == ops[i].name()) {
+        continue;
+      }
+      if (!has_fused) {
+        ss << "Fused:" << std::endl;
+        has_fused = true;
+      }
+      ss << "    * " << chain.str() << std::endl;
+    }
+
     return ss.str();
   }
 };
@@ -36,6 +36,13 @@ bool DAGStreaming::init(const std::string& dag_config_path) {
     return false;
   }
 
+  if (!FLAGS_trace_file.empty() &&
+      !crdc::airi::common::Singleton<Tracer>::get()->init(FLAGS_trace_file,
+                                                          FLAGS_trace_buffer_size)) {
+    LOG(ERROR) << "Failed to init tracer";
+    return false;
+  }
+
   if (!init_dag()) {
     LOG(ERROR) << "Failed to init dag";
     return false;
@@ -58,6 +65,8 @@ void DAGStreaming::schedule() {
     op->join();
     LOG(INFO) << "DAGStreaming: " << *op << " joined";
   }
+  crdc::airi::common::Singleton<WorkStealingPool>::get()->stop();
+  crdc::airi::common::Singleton<Tracer>::get()->flush();
   shared_data_manager_->reset();
   LOG(INFO) << "DAGStreaming schedule exit.";
 }
@@ -72,9 +81,11 @@ void DAGStreaming::stop() {
   LOG(WARNING) << "DAGStreaming stopped.";
 }
 
-bool DAGStreaming::registe_data(std::string data_name, int hz, std::string data_type) {
+bool DAGStreaming::registe_data(std::string data_name, int hz, std::string data_type,
+                                OperatorOutput::CacheBackend backend,
+                                uint32_t byte_budget_mb) {
   if (hz > 0) {
-    if (!shared_data_manager_->register_frame_cached_data(data_name, hz)) {
+    if (!shared_data_manager_->register_frame_cached_data(data_name, hz, backend)) {
       LOG(ERROR) << "Failed to register_frame_cached_data for [" << data_name << "], hz:<"
                  << hz << ">";
       return false;
@@ -86,9 +97,15 @@ bool DAGStreaming::registe_data(std::string data_name, int hz, std::string data_
       return false;
     }
   }
+  if (byte_budget_mb > 0 &&
+      !shared_data_manager_->set_byte_budget(data_name,
+                                             static_cast<size_t>(byte_budget_mb) << 20)) {
+    return false;
+  }
   FrameCachedData* data =
       dynamic_cast<FrameCachedData*>(shared_data_manager_->get_shared_data(data_name));
-  LOG(INFO) << "Setup New CachedData `" << data_name << "` with HZ:" << data->hz();
+  LOG(INFO) << "Setup New CachedData `" << data_name << "` with HZ:" << data->hz()
+            << " backend:" << OperatorOutput::CacheBackend_Name(backend);
   return true;
 }
 
@@ -108,7 +125,8 @@ bool DAGStreaming::registe_data(const std::vector<OperatorConfig>& ops) {
         if (output.has_hz()) {
           hz = output.hz();
         }
-        if (!registe_data(output_data, hz, output.type())) {
+        if (!registe_data(output_data, hz, output.type(), output.cache_backend(),
+                          output.byte_budget_mb())) {
           return false;
         }
         if (!shared_data_manager_->register_data_event(output_data, output.event())) {
@@ -127,7 +145,8 @@ bool DAGStreaming::registe_data(const std::vector<OperatorConfig>& ops) {
         if (downstream.has_hz()) {
           hz = downstream.hz();
         }
-        if (!registe_data(output_data, hz, downstream.type())) {
+        if (!registe_data(output_data, hz, downstream.type(), downstream.cache_backend(),
+                          downstream.byte_budget_mb())) {
           return false;
         }
         new_data.insert(output_data);
@@ -141,7 +160,8 @@ bool DAGStreaming::registe_data(const std::vector<OperatorConfig>& ops) {
         hz = output.hz();
       }
       LOG(INFO) << data_name << " " << output.type();
-      if (!registe_data(data_name, hz, output.type())) {
+      if (!registe_data(data_name, hz, output.type(), output.cache_backend(),
+                        output.byte_budget_mb())) {
         return false;
       }
       new_data.insert(data_name);
@@ -194,6 +214,10 @@ bool DAGStreaming::parse_config(const DAGConfig& dag_config) {
     return false;
   }
 
+  if (FLAGS_enable_operator_fusion && !DAG::fuse_operator(&ops)) {
+    return false;
+  }
+
   LOG(INFO) << "DAG SUMMARY:" << std::endl << DAG::summary(ops);
 
   if (!registe_data(ops)) {
@@ -229,6 +253,17 @@ bool DAGStreaming::init_dag() {
     if (op.upstream_size() > 0) {
       operator_sub_events_[i].resize(op.trigger_size());
     }
+    if (op.trigger_queue_policy_size() > 0 &&
+        op.trigger_queue_policy_size() != op.trigger_size()) {
+      LOG(ERROR) << "[" << op.name() << "] trigger_queue_policy size does not match trigger: "
+                 << op.trigger_queue_policy_size() << " vs. " << op.trigger_size();
+      return false;
+    }
+    if (op.trigger_queue_size_size() > 0 && op.trigger_queue_size_size() != op.trigger_size()) {
+      LOG(ERROR) << "[" << op.name() << "] trigger_queue_size size does not match trigger: "
+                 << op.trigger_queue_size_size() << " vs. " << op.trigger_size();
+      return false;
+    }
   }
 
   int event_id = 0;
@@ -265,6 +300,12 @@ bool DAGStreaming::init_dag() {
         meta.from_node = from_worker;
         meta.to_node = to_worker;
         meta.event_id = ++event_id;
+        if (down_op.trigger_queue_policy_size() > down_trigger_id) {
+          meta.queue_policy = down_op.trigger_queue_policy(down_trigger_id);
+        }
+        if (down_op.trigger_queue_size_size() > down_trigger_id) {
+          meta.queue_size = down_op.trigger_queue_size(down_trigger_id);
+        }
         std::ostringstream name_ss;
         name_ss << op.name() << "[" << j << "]_to_" << down_op.name() << "[" << down_trigger_id
                 << "]";
@@ -285,6 +326,15 @@ bool DAGStreaming::init_dag() {
     return false;
   }
 
+  std::vector<std::string> op_names;
+  for (auto& op : config_.op()) {
+    op_names.emplace_back(op.name());
+  }
+  if (!crdc::airi::common::Singleton<OperatorStatusBoard>::get()->init(op_names)) {
+    LOG(ERROR) << "failed to init OperatorStatusBoard.";
+    return false;
+  }
+
   for (int i = 0; i < config_.op_size(); ++i) {
     const auto& op = config_.op(i);
     auto& op_ptr = ops_[i];
@@ -303,10 +353,35 @@ void DAGStreaming::remove_stale_data() {
   const auto dt = std::chrono::microseconds(n_usec);
   const uint64_t sleep_count = 1000000 / n_usec;
 
+  uint64_t loop = 0;
   while (!stop_) {
     if (FLAGS_enable_timing_remove_stale_data) {
       shared_data_manager_->remove_stale_data();
     }
+    shared_data_manager_->enforce_byte_budget();
+    ++loop;
+    if (FLAGS_shared_data_memory_report_interval > 0 &&
+        loop % FLAGS_shared_data_memory_report_interval == 0) {
+      LOG(INFO) << shared_data_manager_->memory_report();
+    }
+    if (FLAGS_event_queue_report_interval > 0 &&
+        loop % FLAGS_event_queue_report_interval == 0) {
+      LOG(INFO) << event_manager_->queue_report();
+    }
+    if (FLAGS_operator_status_report_interval > 0 &&
+        loop % FLAGS_operator_status_report_interval == 0) {
+      LOG(INFO) << crdc::airi::common::Singleton<OperatorStatusBoard>::get()->report();
+    }
+    if (FLAGS_enable_latency_histogram && FLAGS_latency_report_interval > 0 &&
+        loop % FLAGS_latency_report_interval == 0) {
+      for (auto& op : ops_) {
+        LOG(INFO) << op->latency_report();
+      }
+    }
+    if (FLAGS_enable_latency_trace && FLAGS_latency_report_interval > 0 &&
+        loop % FLAGS_latency_report_interval == 0) {
+      LOG(INFO) << event_manager_->trace_report();
+    }
     for (uint64_t c = 0; c < sleep_count; ++c) {
       if (stop_) {
         return;
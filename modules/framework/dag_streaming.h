@@ -17,6 +17,11 @@ namespace airi {
 
 DECLARE_int32(max_allowed_congestion_value);
 DECLARE_bool(enable_timing_remove_stale_data);
+DECLARE_int32(shared_data_memory_report_interval);
+DECLARE_int32(event_queue_report_interval);
+DECLARE_int32(operator_status_report_interval);
+DECLARE_bool(enable_operator_fusion);
+DECLARE_bool(enable_latency_trace);
 
 /**
  * @brief This Class is used to create the app by dag file.
@@ -66,8 +71,12 @@ class DAGStreaming : public crdc::airi::common::Thread {
    * @param the name of the data [std::string]
    * @param the input frequence [int]
    * @param the type of the data [std::string]
+   * @param the storage of the data with hz [OperatorOutput::CacheBackend]
+   * @param the max memory of the data in MB, 0 for the default [uint32_t]
    */
-  bool registe_data(std::string data_name, int hz, std::string data_type);
+  bool registe_data(std::string data_name, int hz, std::string data_type,
+                    OperatorOutput::CacheBackend backend = OperatorOutput::MAP,
+                    uint32_t byte_budget_mb = 0);
 
  private:
   /**
@@ -84,7 +93,8 @@ class DAGStreaming : public crdc::airi::common::Thread {
 
   /**
    * @brief Some cache data is stored. If the remove staled data flag is opened.
-   * The staled data could be removed with this method.
+   * The staled data could be removed with this method. It also keeps the shared
+   * data in the byte budget and reports the memory periodically.
    */
   void remove_stale_data();
 
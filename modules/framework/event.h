@@ -50,11 +50,16 @@ struct EventMeta {
   WorkerID to_node = 0;
   WorkerID from_node = 0;
   std::string name;
+  // OperatorConfig::QueuePolicy of the event queue
+  int queue_policy = 0;
+  // the max size of the event queue, 0 for the default
+  int queue_size = 0;
   EventMeta(): event_id(0), to_node(0), from_node(0) {}
   std::string to_string() const {
     std::ostringstream oss;
     oss << "event_id: " << event_id << " name: '" << name
-      << "' from_node: " << from_node << " to_node: " << to_node;
+      << "' from_node: " << from_node << " to_node: " << to_node
+      << " queue_policy: " << queue_policy << " queue_size: " << queue_size;
     return oss.str();
   }
 };
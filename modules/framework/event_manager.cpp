@@ -4,6 +4,8 @@
 // Description: Event Manager
 
 #include "framework/event_manager.h"
+#include "framework/frame.h"
+#include "framework/work_stealing_pool.h"
 
 namespace crdc {
 namespace airi {
@@ -15,136 +17,203 @@ bool EventManager::init(const std::vector<EventMeta>& events, const DAGConfig& d
   }
 
   for (auto& event_meta : events) {
-    if (event_queue_map_.find(event_meta.event_id) != event_queue_map_.end()) {
+    if (event_meta.event_id < 0) {
+      LOG(ERROR) << "invalid event id in config. id: " << event_meta.event_id;
+      return false;
+    }
+    if (static_cast<size_t>(event_meta.event_id) >= event_queues_.size()) {
+      event_queues_.resize(event_meta.event_id + 1);
+    }
+    if (event_queues_[event_meta.event_id]) {
       LOG(ERROR) << "duplicate event id in config. id: " << event_meta.event_id;
       return false;
     }
-    event_queue_map_[event_meta.event_id].reset(new EventQueue(FLAGS_max_event_queue_size));
+    auto policy = static_cast<QueuePolicy>(event_meta.queue_policy);
+    int queue_size = event_meta.queue_size > 0 ? event_meta.queue_size
+                                               : FLAGS_max_event_queue_size;
+    if (policy == OperatorConfig::LATEST) {
+      queue_size = 1;
+    }
+    event_queues_[event_meta.event_id].reset(
+        new EventQueue(event_meta.event_id, policy, queue_size));
     event_meta_map_.emplace(event_meta.event_id, event_meta);
+    // the footprint of the event, marked on the frames by Port::publish
+    FootprintRegistry::intern(event_meta.name);
     LOG(INFO) << "Load EventMeta: " << event_meta.to_string();
   }
 
-  LOG(INFO) << "Load " << event_queue_map_.size() << " events in DAGSreaming.";
+  LOG(INFO) << "Load " << event_meta_map_.size() << " events in DAGSreaming.";
+
+  init_pipelines(events);
 
-  std::vector<EventID> event_ids(events.size());
-  std::unordered_map<EventID, int> event_id_map;
-  for (size_t i = 0; i < events.size(); ++i) {
-    event_ids[i] = events[i].event_id;
-    event_id_map[events[i].event_id] = i;
+  inited_ = true;
+  return true;
+}
+
+void EventManager::init_pipelines(const std::vector<EventMeta>& events) {
+  const size_t n = events.size();
+  // event j follows event i if i goes to the node which j comes from
+  std::unordered_map<WorkerID, std::vector<int>> from_node_events;
+  for (size_t i = 0; i < n; ++i) {
+    from_node_events[events[i].from_node].emplace_back(i);
   }
-  std::vector<std::vector<int>> adj(events.size(), std::vector<int>(events.size(), 0));
-  for (size_t i = 0; i < events.size(); ++i) {
-    auto& e1 = events[i];
-    int e1_idx = event_id_map[e1.event_id];
-    for (size_t j = 0; j < events.size(); ++j) {
-      if (i == j) {
+  std::vector<std::vector<int>> adj(n);
+  std::vector<int> in_degree(n, 0);
+  for (size_t i = 0; i < n; ++i) {
+    auto iter = from_node_events.find(events[i].to_node);
+    if (iter == from_node_events.end()) {
+      continue;
+    }
+    for (int j : iter->second) {
+      if (j == static_cast<int>(i)) {
         continue;
       }
-      auto& e2 = events[j];
-      int e2_idx = event_id_map[e2.event_id];
-      if (e1.to_node == e2.from_node) {
-        adj[e1_idx][e2_idx] = 1;
-      }
+      adj[i].emplace_back(j);
+      ++in_degree[j];
     }
   }
 
-  std::vector<int> heads;
-  for (size_t i = 0; i < events.size(); ++i) {
-    int sum = 0;
-    for (size_t j = 0; j < events.size(); ++j) {
-      sum += adj[j][i];
-    }
-    if (sum == 0) {
-      heads.emplace_back(i);
+  // topological order by Kahn's algorithm, the events on a cycle are left out
+  std::vector<int> order;
+  order.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    if (in_degree[i] == 0) {
+      order.emplace_back(i);
     }
   }
-  for (auto& h : heads) {
-    auto& event = event_meta_map_[event_ids[h]];
-    LOG(INFO) << "Event Head: " << event.name;
-    for (auto& p : traverse(h, adj)) {
-      std::vector<EventID> link;
-      std::transform(p.rbegin(), p.rend(), std::back_inserter(link),
-                     [&](const int i) -> EventID { return event_ids[i]; });
-      pipelines_.emplace_back(link);
+  const size_t num_heads = order.size();
+  for (size_t k = 0; k < order.size(); ++k) {
+    for (int j : adj[order[k]]) {
+      if (--in_degree[j] == 0) {
+        order.emplace_back(j);
+      }
     }
   }
+  if (order.size() != n) {
+    LOG(WARNING) << "Event graph has a cycle, " << n - order.size()
+                 << " events are not counted in the pipelines.";
+  }
 
-  LOG(INFO) << "Event Pipelines: " << pipelines_.size();
-  for (size_t i = 0; i < pipelines_.size(); ++i) {
-    std::stringstream ss;
-    ss << "Event Pipeline #" << i << std::endl;
-    for (auto& e : pipelines_[i]) {
-      if (event_meta_map_.find(e) == event_meta_map_.end()) {
-        LOG(ERROR) << "No such event: " << e;
-        continue;
+  // number of the paths from each event to a tail and the longest one, from the tails
+  auto saturated_add = [](uint64_t a, uint64_t b) -> uint64_t {
+    return b > UINT64_MAX - a ? UINT64_MAX : a + b;
+  };
+  std::vector<uint64_t> num_paths(n, 0);
+  std::vector<int> depth(n, 1);
+  std::vector<int> next(n, -1);
+  for (auto iter = order.rbegin(); iter != order.rend(); ++iter) {
+    int i = *iter;
+    if (adj[i].empty()) {
+      num_paths[i] = 1;
+      continue;
+    }
+    for (int j : adj[i]) {
+      // saturates instead of overflow on a huge dag
+      num_paths[i] = saturated_add(num_paths[i], num_paths[j]);
+      if (depth[j] + 1 > depth[i]) {
+        depth[i] = depth[j] + 1;
+        next[i] = j;
       }
-      auto& event = event_meta_map_.at(e);
-      ss << "    * " << event.name << std::endl;
     }
-    LOG(INFO) << ss.str();
   }
 
-  inited_ = true;
-  return true;
-}
-
-std::vector<std::vector<int>>
-  EventManager::traverse(const int& idx, const std::vector<std::vector<int>>& adj) {
-  std::vector<std::vector<int>> ret;
-  int sum = 0;
-  for (auto& c : adj.at(idx)) {
-    sum += c;
+  num_pipelines_ = 0;
+  int critical_head = -1;
+  for (size_t k = 0; k < num_heads; ++k) {
+    int h = order[k];
+    num_pipelines_ = saturated_add(num_pipelines_, num_paths[h]);
+    if (critical_head < 0 || depth[h] > depth[critical_head]) {
+      critical_head = h;
+    }
+    LOG(INFO) << "Event Head: " << events[h].name << " pipelines: " << num_paths[h]
+              << " max length: " << depth[h];
   }
-  if (sum == 0) {
-    ret.emplace_back(std::vector<int>{idx});
-    return ret;
+  critical_path_.clear();
+  for (int i = critical_head; i >= 0; i = next[i]) {
+    critical_path_.emplace_back(events[i].event_id);
   }
-  for (size_t i = 0; i < adj.at(idx).size(); ++i) {
-    if (adj.at(idx).at(i)) {
-      for (auto s : traverse(i, adj)) {
-        s.emplace_back(idx);
-        ret.emplace_back(s);
-      }
-    }
+
+  LOG(INFO) << "Event Pipelines: " << num_pipelines_;
+  std::stringstream ss;
+  ss << "Event Critical Pipeline" << std::endl;
+  for (auto& e : critical_path_) {
+    ss << "    * " << event_meta_map_.at(e).name << std::endl;
   }
-  return ret;
+  LOG(INFO) << ss.str();
 }
 
 bool EventManager::publish(const Event& event) {
-  EventQueue* queue = NULL;
-  if (!get_event_queue(event.event_id, &queue)) {
+  return publish(event, false);
+}
+
+bool EventManager::publish(const Event& event, bool nonblocking) {
+  EventQueue* queue = get_event_queue(event.event_id);
+  if (!queue) {
     return false;
   }
+  publish(queue, event, nonblocking);
+  return true;
+}
 
-  if (!queue->try_push(event)) {
-    // Critical errors: queue is full.
-    LOG(ERROR) << "EventQueue is FULL. id: " << event.event_id
-           << ", name: " << event_meta_map_[event.event_id].name;
-    // Clear all blocked data.
-    LOG(ERROR) << "clear EventQueue. id: " << event.event_id << " size: " << queue->size();
-    queue->clear();
+void EventManager::publish(EventQueue* queue, const Event& event, bool nonblocking) {
+  push(queue, event, nonblocking);
+  if (queue->on_publish) {
+    queue->on_publish();
+  }
+}
 
-    // try second time.
-    queue->try_push(event);
+void EventManager::push(EventQueue* queue, const Event& event, bool nonblocking) {
+  if (queue->channel.try_push(event)) {
+    return;
   }
 
-  return true;
+  uint64_t dropped = 0;
+  switch (queue->policy) {
+    case OperatorConfig::LATEST:
+    case OperatorConfig::DROP_OLDEST:
+      queue->overwritten.fetch_add(queue->channel.push_overwrite(event),
+                                   std::memory_order_relaxed);
+      return;
+    case OperatorConfig::BLOCK:
+      // a pool thread never waits, the consumer could be queued on the same thread
+      if (!nonblocking && !WorkStealingPool::in_pool() &&
+          queue->channel.push(event, FLAGS_event_queue_block_timeout * 1000LL)) {
+        return;
+      }
+      dropped = queue->dropped.fetch_add(1, std::memory_order_relaxed);
+      break;
+    case OperatorConfig::DROP_NEWEST:
+      dropped = queue->dropped.fetch_add(1, std::memory_order_relaxed);
+      break;
+    default:
+      // clear all blocked data, then try second time.
+      dropped = queue->dropped.fetch_add(queue->channel.size(), std::memory_order_relaxed);
+      queue->channel.clear();
+      queue->channel.try_push(event);
+      break;
+  }
+  // only the first drop is logged, the others are counted for queue_report()
+  if (dropped == 0) {
+    LOG(ERROR) << "EventQueue is FULL. id: " << queue->event_id
+               << ", name: " << event_meta_map_.at(queue->event_id).name
+               << ", policy: " << OperatorConfig::QueuePolicy_Name(queue->policy);
+  }
 }
 
 bool EventManager::subscribe(EventID event_id, Event* event, bool nonblocking) {
-  EventQueue* queue = NULL;
-  if (!get_event_queue(event_id, &queue)) {
+  EventQueue* queue = get_event_queue(event_id);
+  if (!queue) {
     return false;
   }
 
   if (nonblocking) {
-    return queue->try_pop(event);
+    return queue->channel.try_pop(event);
   }
 
   LOG(INFO) << "EVENT_ID: " << event_id
-    << ", NAME: " << event_meta_map_[event_id].name
-    << ", QUEUE LENGTH:" << queue->size();
-  queue->pop(event);
+    << ", NAME: " << event_meta_map_.at(event_id).name
+    << ", QUEUE LENGTH:" << queue->channel.size();
+  queue->channel.pop(event);
   return true;
 }
 
@@ -152,16 +221,25 @@ bool EventManager::subscribe(EventID event_id, Event* event) {
   return subscribe(event_id, event, false);
 }
 
-bool EventManager::get_event_queue(EventID event_id, EventQueue** queue) {
-  EventQueueMapIterator iter = event_queue_map_.find(event_id);
-  if (iter == event_queue_map_.end()) {
-    LOG(ERROR) << "event: " << event_id << " not exist in EventQueueMap.";
-    return false;
-  }
+void EventManager::subscribe(EventQueue* queue, Event* event) {
+  queue->channel.pop(event);
+}
 
-  CHECK(queue != NULL) << " event_id: " << event_id;
-  *queue = iter->second.get();
-  return true;
+void EventManager::set_publish_callback(EventQueue* queue, std::function<void()> callback) {
+  queue->on_publish = std::move(callback);
+}
+
+void EventManager::set_inline_callback(EventQueue* queue, InlineCallback callback) {
+  queue->on_inline = std::move(callback);
+}
+
+EventManager::EventQueue* EventManager::get_event_queue(EventID event_id) {
+  if (event_id < 0 || static_cast<size_t>(event_id) >= event_queues_.size() ||
+      !event_queues_[event_id]) {
+    LOG(ERROR) << "event: " << event_id << " not exist in EventManager.";
+    return nullptr;
+  }
+  return event_queues_[event_id].get();
 }
 
 bool EventManager::get_event_meta(EventID event_id, EventMeta* event_meta) const {
@@ -189,30 +267,146 @@ bool EventManager::get_event_meta(const std::vector<EventID>& event_ids,
 }
 
 int EventManager::avg_len_of_event_queues() const {
-  if (event_queue_map_.empty()) {
+  if (event_meta_map_.empty()) {
     return 0;
   }
 
   int total_length = 0;
-  for (const auto& event : event_queue_map_) {
-    total_length += event.second->size();
+  for (const auto& queue : event_queues_) {
+    if (queue) {
+      total_length += queue->channel.size();
+    }
   }
-  return total_length / event_queue_map_.size();
+  return total_length / static_cast<int>(event_meta_map_.size());
 }
 
 int EventManager::max_len_of_event_queues() const {
   int max_length = 0;
-  for (const auto& event : event_queue_map_) {
-    max_length = std::max(max_length, event.second->size());
+  for (const auto& queue : event_queues_) {
+    if (queue) {
+      max_length = std::max(max_length, queue->channel.size());
+    }
   }
   return max_length;
 }
 
 void EventManager::reset() {
-  EventQueueMapIterator iter = event_queue_map_.begin();
-  for (; iter != event_queue_map_.end(); ++iter) {
-    iter->second->clear();
+  for (auto& queue : event_queues_) {
+    if (queue) {
+      queue->channel.clear();
+    }
+  }
+}
+
+std::string EventManager::queue_report() const {
+  std::ostringstream oss;
+  oss << "EventQueue drops:" << std::endl;
+  for (const auto& queue : event_queues_) {
+    if (!queue) {
+      continue;
+    }
+    uint64_t dropped = queue->dropped.load(std::memory_order_relaxed);
+    uint64_t overwritten = queue->overwritten.load(std::memory_order_relaxed);
+    if (dropped == 0 && overwritten == 0) {
+      continue;
+    }
+    oss << "    * " << event_meta_map_.at(queue->event_id).name << " ("
+        << OperatorConfig::QueuePolicy_Name(queue->policy) << ") dropped: " << dropped
+        << " overwritten: " << overwritten << std::endl;
+  }
+  return oss.str();
+}
+
+EventManager::PipelineTrace* EventManager::find_trace_locked(uint64_t hash,
+                                                             const FrameTrace& trace) {
+  auto iter = traces_.find(hash);
+  if (iter == traces_.end()) {
+    return nullptr;
+  }
+  // the paths of the same hash are compared hop by hop, a collision is another entry
+  for (auto& pipeline : iter->second) {
+    if (pipeline->path.size() != static_cast<size_t>(trace.num_hops)) {
+      continue;
+    }
+    bool same = true;
+    for (int i = 0; i < trace.num_hops && same; ++i) {
+      same = pipeline->path[i] == trace.hops[i].event_id;
+    }
+    if (same) {
+      return pipeline.get();
+    }
+  }
+  return nullptr;
+}
+
+EventManager::PipelineTrace* EventManager::find_trace(uint64_t hash, const FrameTrace& trace) {
+  std::shared_lock<std::shared_timed_mutex> lock(trace_lock_);
+  return find_trace_locked(hash, trace);
+}
+
+void EventManager::record_trace(const FrameTrace& trace, uint64_t now) {
+  if (trace.truncated || trace.num_hops == 0 || trace.origin == 0 || now < trace.origin) {
+    return;
+  }
+  // FNV-1a of the event ids, no allocation on the path of each frame
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < trace.num_hops; ++i) {
+    hash = (hash ^ static_cast<uint64_t>(trace.hops[i].event_id)) * 1099511628211ULL;
+  }
+  auto us = [](uint64_t from, uint64_t to) { return to > from ? (to - from) * 1000 : 0; };
+
+  // the histograms are lock free, the lock only guards the lookup and the first
+  // frame of a new pipeline, so the tail frames of the pipelines do not serialize
+  PipelineTrace* pipeline = find_trace(hash, trace);
+  if (!pipeline) {
+    std::lock_guard<std::shared_timed_mutex> lock(trace_lock_);
+    pipeline = find_trace_locked(hash, trace);
+    if (!pipeline) {
+      std::unique_ptr<PipelineTrace> created(new PipelineTrace);
+      for (int i = 0; i < trace.num_hops; ++i) {
+        created->path.emplace_back(trace.hops[i].event_id);
+        created->queue.emplace_back(new LatencyHistogram);
+        created->wait.emplace_back(new LatencyHistogram);
+        created->process.emplace_back(new LatencyHistogram);
+      }
+      pipeline = created.get();
+      traces_[hash].emplace_back(std::move(created));
+    }
+  }
+  pipeline->total.record(us(trace.origin, now));
+  for (int i = 0; i < trace.num_hops; ++i) {
+    auto& hop = trace.hops[i];
+    pipeline->queue[i]->record(us(hop.enqueue, hop.dequeue));
+    if (hop.process_start > 0) {
+      pipeline->wait[i]->record(us(hop.dequeue, hop.process_start));
+      pipeline->process[i]->record(us(hop.process_start, hop.process_end));
+    }
+  }
+}
+
+std::string EventManager::trace_report() const {
+  std::ostringstream oss;
+  oss << "Pipeline latency:" << std::endl;
+  std::shared_lock<std::shared_timed_mutex> lock(trace_lock_);
+  for (const auto& item : traces_) {
+    for (const auto& entry : item.second) {
+      auto& pipeline = *entry;
+      oss << "    * ";
+      for (size_t i = 0; i < pipeline.path.size(); ++i) {
+        oss << (i > 0 ? " -> " : "") << event_meta_map_.at(pipeline.path[i]).name;
+      }
+      if (pipeline.path == critical_path_) {
+        oss << " (critical)";
+      }
+      oss << std::endl << "        total " << pipeline.total.to_string() << std::endl;
+      for (size_t i = 0; i < pipeline.path.size(); ++i) {
+        oss << "        [" << i << "] queue " << pipeline.queue[i]->to_string() << std::endl
+            << "            wait " << pipeline.wait[i]->to_string() << std::endl
+            << "            process " << pipeline.process[i]->to_string() << std::endl;
+      }
+    }
   }
+  return oss.str();
 }
 
 }  // namespace airi
@@ -7,23 +7,58 @@
 
 #include <gflags/gflags.h>
 
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <sstream>
+#include <string>
 #include <unordered_map>
 #include <vector>
 #include <algorithm>
 
+#include "common/bounded_channel.h"
 #include "common/common.h"
 #include "framework/event.h"
+#include "framework/footprint.h"
+#include "framework/latency_histogram.h"
 #include "framework/proto/dag_config.pb.h"
 
 namespace crdc {
 namespace airi {
 
 DECLARE_int32(max_event_queue_size);
+DECLARE_int32(event_queue_block_timeout);
+
+class Frame;
+struct FrameTrace;
 
 class EventManager {
  public:
+  using QueuePolicy = OperatorConfig::QueuePolicy;
+  using EventChannel = crdc::airi::common::BoundedChannel<Event>;
+  using InlineCallback = std::function<void(const Event&, const std::shared_ptr<Frame>&)>;
+
+  // one publisher and one subscriber on each event
+  struct EventQueue {
+    EventQueue(EventID event_id, QueuePolicy policy, size_t max_count)
+      : event_id(event_id), policy(policy), channel(max_count) {}
+    ALIGNED_NEW(64);
+    EventID event_id;
+    QueuePolicy policy;
+    EventChannel channel;
+    // the events dropped when the queue is full
+    std::atomic<uint64_t> dropped{0};
+    // the queued events replaced by the new ones (LATEST / DROP_OLDEST)
+    std::atomic<uint64_t> overwritten{0};
+    // called after each publish, for the subscriber which does not block on the queue
+    std::function<void()> on_publish;
+    // set by the INLINE subscriber, which runs the frame on the thread of the publisher
+    // instead of the queue
+    InlineCallback on_inline;
+  };
+
   EventManager() = default;
   ~EventManager() = default;
 
@@ -33,45 +68,131 @@ class EventManager {
   // thread-safe.
   bool publish(const Event& event);
 
+  // never waits on a full BLOCK queue if nonblocking.
+  // thread-safe.
+  bool publish(const Event& event, bool nonblocking);
+
   // if no event arrive, this api would be block.
   // thread-safe.
   bool subscribe(EventID event_id, Event* event);
 
   bool subscribe(EventID event_id, Event* event, bool nonblocking);
 
+  /**
+   * @brief get the queue of the event, resolved once by the ports, so that
+   *        publish and subscribe on it need no lookup.
+   * @param [in] the event id
+   * @return the queue, nullptr if the event does not exist [EventQueue*]
+   */
+  EventQueue* get_event_queue(EventID event_id);
+
+  // thread-safe.
+  void publish(EventQueue* queue, const Event& event, bool nonblocking = false);
+
+  // blocks until an event arrives.
+  // thread-safe.
+  void subscribe(EventQueue* queue, Event* event);
+
+  /**
+   * @brief set the callback of the queue after each publish, which schedules the
+   *        pooled subscriber. Not thread-safe, set it before the events flow.
+   */
+  void set_publish_callback(EventQueue* queue, std::function<void()> callback);
+
+  /**
+   * @brief set the INLINE subscriber of the queue, Port::publish hands the frame to
+   *        it instead of publishing the event. Not thread-safe, set it before the
+   *        events flow.
+   */
+  void set_inline_callback(EventQueue* queue, InlineCallback callback);
+
   // clear all the event queues.
   void reset();
   int avg_len_of_event_queues() const;
   int max_len_of_event_queues() const;
 
+  /**
+   * @brief the dropped and overwritten events of each queue
+   */
+  std::string queue_report() const;
+
   bool get_event_meta(EventID event_id, EventMeta* event_meta) const;
   bool get_event_meta(const std::vector<EventID>& event_ids,
                       std::vector<EventMeta>* event_metas) const;
 
-  int num_events() const { return event_queue_map_.size(); }
+  int num_events() const { return event_meta_map_.size(); }
+
+  /**
+   * @brief the number of the event paths from a head to a tail
+   */
+  uint64_t num_pipelines() const { return num_pipelines_; }
+
+  /**
+   * @brief the longest event path from a head to a tail
+   */
+  const std::vector<EventID>& critical_path() const { return critical_path_; }
+
+  /**
+   * @brief aggregate the trace of a frame which leaves its pipeline. The pipeline is
+   *        the path of the events it triggered, the truncated traces are skipped.
+   * @param [in] the trace
+   * @param [in] the time the frame leaves, us
+   */
+  void record_trace(const FrameTrace& trace, uint64_t now);
+
+  /**
+   * @brief the end to end latency of each pipeline from the origin of the frames,
+   *        with the queue, wait and process time of each hop
+   */
+  std::string trace_report() const;
 
  protected:
-  std::vector<std::vector<int>> traverse(const int& idx, const std::vector<std::vector<int>>& adj);
+  /**
+   * @brief count the pipelines and find the critical one on the sparse event graph,
+   *        without walking each path. The events on a cycle are left out.
+   */
+  void init_pipelines(const std::vector<EventMeta>& events);
+
+  /**
+   * @brief push the event by the policy of the queue
+   */
+  void push(EventQueue* queue, const Event& event, bool nonblocking);
 
  private:
   friend class crdc::airi::common::Singleton<EventManager>;
 
-  using EventQueue = crdc::airi::common::FixedSizeConQueue<Event>;
-  using EventQueueMap = std::unordered_map<EventID, std::unique_ptr<EventQueue>>;
-  using EventQueueMapIterator = EventQueueMap::iterator;
-  using EventQueueMapConstIterator = EventQueueMap::const_iterator;
   using EventMetaMap = std::unordered_map<EventID, EventMeta>;
   using EventMetaMapIterator = EventMetaMap::iterator;
   using EventMetaMapConstIterator = EventMetaMap::const_iterator;
 
-  bool get_event_queue(EventID event_id, EventQueue** queue);
-
-  EventQueueMap event_queue_map_;
+  // indexed by the event id, which is given densely from 1 by DAGStreaming
+  std::vector<std::unique_ptr<EventQueue>> event_queues_;
   // for debug.
   EventMetaMap event_meta_map_;
   bool inited_ = false;
 
-  std::vector<std::vector<EventID>> pipelines_;
+  uint64_t num_pipelines_ = 0;
+  std::vector<EventID> critical_path_;
+
+  // the latency of the frames through a pipeline
+  struct PipelineTrace {
+    std::vector<EventID> path;
+    LatencyHistogram total;
+    // the time of each hop: published to taken, taken to started, started to ended
+    std::vector<std::unique_ptr<LatencyHistogram>> queue;
+    std::vector<std::unique_ptr<LatencyHistogram>> wait;
+    std::vector<std::unique_ptr<LatencyHistogram>> process;
+  };
+  /**
+   * @brief the pipeline of the same path as the trace, nullptr if not found
+   */
+  PipelineTrace* find_trace(uint64_t hash, const FrameTrace& trace);
+  PipelineTrace* find_trace_locked(uint64_t hash, const FrameTrace& trace);
+
+  // by the hash of the path, the pipelines of a colliding hash share the entry
+  std::unordered_map<uint64_t, std::vector<std::unique_ptr<PipelineTrace>>> traces_;
+  // shared by the recording tail frames, exclusive for a new pipeline
+  mutable std::shared_timed_mutex trace_lock_;
 
   DISALLOW_COPY_AND_ASSIGN(EventManager);
 };
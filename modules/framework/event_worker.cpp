@@ -5,6 +5,8 @@
 
 #include "framework/event_worker.h"
 #include "framework/operator.h"
+#include "framework/tracer.h"
+#include "framework/work_stealing_pool.h"
 
 namespace crdc {
 namespace airi {
@@ -52,6 +54,7 @@ void EventWorker::peek_event() {
 }
 
 inline void EventWorker::proc_events() {
+  TraceSpan span(trace_name_, 0);
   Status status = op_->proc_events(idx_);
   ++total_count_;
   if (status == Status::FAIL) {
@@ -87,6 +90,72 @@ void EventWorker::process_operator() {
   }
 }
 
+void EventWorker::start_pooled() {
+  LOG(INFO) << "EventWorker[" << worker_name_ << "] starts in pool.";
+  stop_ = false;
+  if (op_->has_event(idx_)) {
+    schedule();
+  }
+}
+
+void EventWorker::schedule() {
+  if (stop_ || scheduled_.exchange(true)) {
+    return;
+  }
+  crdc::airi::common::Singleton<WorkStealingPool>::get()->submit(get_priority(),
+                                                                 [this] { run_task(); });
+}
+
+void EventWorker::run_task() {
+  if (!stop_) {
+    if (!peeked_) {
+      peeked_ = true;
+      peek_event();
+    } else {
+      proc_events();
+    }
+  }
+  scheduled_ = false;
+  // an event published before scheduled_ is cleared found the task still running
+  if (!stop_ && op_->has_event(idx_)) {
+    schedule();
+  }
+}
+
+void EventWorker::wait_task() {
+  while (scheduled_) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void EventWorker::start_inlined() {
+  LOG(INFO) << "EventWorker[" << worker_name_ << "] starts on its upstream.";
+  stop_ = false;
+}
+
+void EventWorker::run_inline(const Event& event, const std::shared_ptr<Frame>& frame) {
+  std::lock_guard<std::mutex> lock(inline_lock_);
+  if (stop_) {
+    return;
+  }
+  bool is_peek = !peeked_;
+  peeked_ = true;
+  TraceSpan span(trace_name_, event.timestamp);
+  Status status = op_->proc_inline(idx_, event, frame, is_peek);
+  CHECK(status != Status::FATAL) << *op_ << " output [" << idx_
+                                 << "]: inline event FATAL error, EXIT.";
+  ++total_count_;
+  if (status == Status::FAIL) {
+    ++failed_count_;
+    LOG(WARNING) << *op_ << " output [" << idx_ << "]: inline event failed. "
+                 << " total_count: " << total_count_ << " failed_count: " << failed_count_;
+  }
+}
+
+void EventWorker::wait_inline() {
+  std::lock_guard<std::mutex> lock(inline_lock_);
+}
+
 EventWorker::EventWorker(std::shared_ptr<Operator> op, int idx)
     : crdc::airi::common::Thread(true),
       op_(op),
@@ -100,6 +169,7 @@ EventWorker::EventWorker(std::shared_ptr<Operator> op, int idx)
   if (idx > 0) {
     worker_name_ += "[" + std::to_string(idx) + "]";
   }
+  trace_name_ = crdc::airi::common::Singleton<Tracer>::get()->intern(worker_name_);
 
   std::string thread_name = op->name();
   if (thread_name.length() > 13) {
@@ -5,7 +5,9 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
 #include "common/common.h"
 #include "framework/event.h"
@@ -45,14 +47,74 @@ class EventWorker : public crdc::airi::common::Thread {
   void proc_events();
   void process_cv();
   void process_operator();
+
+  /**
+   * @brief run the events as the tasks of the WorkStealingPool instead of a thread.
+   *        Set by Operator::init_workers for `executor: POOL`.
+   */
+  void set_pooled(bool pooled) { pooled_ = pooled; }
+  bool is_pooled() const { return pooled_; }
+
+  /**
+   * @brief the pooled version of start(), schedules the events already queued
+   */
+  void start_pooled();
+
+  /**
+   * @brief submit a task for the queued events, unless one is submitted already,
+   *        so the events of the worker are processed one at a time.
+   *        Called after each event published to the trigger.
+   */
+  void schedule();
+
+  /**
+   * @brief the task, processes one event then submits the next task if more
+   */
+  void run_task();
+
+  /**
+   * @brief the pooled version of join(), waits for the submitted task
+   */
+  void wait_task();
+
+  /**
+   * @brief run the events on the thread of the upstream, right after its publish.
+   *        Set by Operator::init_workers for `executor: INLINE`.
+   */
+  void set_inlined(bool inlined) { inlined_ = inlined; }
+  bool is_inlined() const { return inlined_; }
+
+  /**
+   * @brief the inline version of start()
+   */
+  void start_inlined();
+
+  /**
+   * @brief process the frame of the event, called by the upstream in its publish
+   */
+  void run_inline(const Event& event, const std::shared_ptr<Frame>& frame);
+
+  /**
+   * @brief the inline version of join(), waits for the running event
+   */
+  void wait_inline();
   friend class Operator;
 
  private:
   std::shared_ptr<Operator> op_;
   std::string worker_name_ = "";
+  // the span name of the events in the tracer
+  int trace_name_ = 0;
   EventMeta event_meta_;
   int idx_;
-  bool stop_;
+  std::atomic<bool> stop_;
+  bool pooled_ = false;
+  bool inlined_ = false;
+  // the upstreams of the inlined worker run one event at a time
+  std::mutex inline_lock_;
+  bool peeked_ = false;
+  // a task of the worker is submitted and not finished
+  std::atomic<bool> scheduled_{false};
   bool inited_;
   size_t total_count_;
   size_t failed_count_;
@@ -0,0 +1,100 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: footprint registry. The event names marked on the frames are interned
+//              to small integer ids, so that a frame keeps its footprints in a bitset.
+
+#include "framework/footprint.h"
+#include <functional>
+
+namespace crdc {
+namespace airi {
+
+const FootprintID FootprintRegistry::kMaxFootprints;
+const size_t FootprintRegistry::kTableSize;
+
+std::mutex& FootprintRegistry::lock() {
+  static std::mutex lock;
+  return lock;
+}
+
+std::unordered_map<std::string, FootprintID>& FootprintRegistry::ids() {
+  static std::unordered_map<std::string, FootprintID> ids;
+  return ids;
+}
+
+std::vector<std::unique_ptr<FootprintRegistry::Entry>>& FootprintRegistry::entries() {
+  static std::vector<std::unique_ptr<Entry>> entries;
+  return entries;
+}
+
+std::atomic<const FootprintRegistry::Entry*>* FootprintRegistry::table() {
+  static std::atomic<const Entry*> table[kTableSize];
+  return table;
+}
+
+std::atomic<const FootprintRegistry::Entry*>* FootprintRegistry::by_id() {
+  static std::atomic<const Entry*> by_id[kMaxFootprints];
+  return by_id;
+}
+
+std::atomic<bool>& FootprintRegistry::overflow() {
+  static std::atomic<bool> overflow{false};
+  return overflow;
+}
+
+FootprintID FootprintRegistry::intern(const std::string& name) {
+  std::unique_lock<std::mutex> guard(lock());
+  auto it = ids().find(name);
+  if (it != ids().end()) {
+    return it->second;
+  }
+  FootprintID id = entries().size();
+  entries().emplace_back(new Entry{name, id});
+  ids().emplace(name, id);
+  const Entry* entry = entries().back().get();
+  if (id >= kMaxFootprints) {
+    overflow().store(true, std::memory_order_release);
+    return id;
+  }
+  // published after the entry is built, the readers never see it half done
+  size_t pos = std::hash<std::string>()(name) & (kTableSize - 1);
+  while (table()[pos].load(std::memory_order_relaxed)) {
+    pos = (pos + 1) & (kTableSize - 1);
+  }
+  table()[pos].store(entry, std::memory_order_release);
+  by_id()[id].store(entry, std::memory_order_release);
+  return id;
+}
+
+FootprintID FootprintRegistry::find(const std::string& name) {
+  // the table is half full at most, so the probe ends at an empty slot
+  size_t pos = std::hash<std::string>()(name) & (kTableSize - 1);
+  while (const Entry* entry = table()[pos].load(std::memory_order_acquire)) {
+    if (entry->name == name) {
+      return entry->id;
+    }
+    pos = (pos + 1) & (kTableSize - 1);
+  }
+  if (!overflow().load(std::memory_order_acquire)) {
+    return -1;
+  }
+  std::unique_lock<std::mutex> guard(lock());
+  auto it = ids().find(name);
+  return it == ids().end() ? -1 : it->second;
+}
+
+std::string FootprintRegistry::name(FootprintID id) {
+  if (id >= 0 && id < kMaxFootprints) {
+    const Entry* entry = by_id()[id].load(std::memory_order_acquire);
+    return entry ? entry->name : "";
+  }
+  std::unique_lock<std::mutex> guard(lock());
+  if (id < 0 || id >= static_cast<FootprintID>(entries().size())) {
+    return "";
+  }
+  return entries()[id]->name;
+}
+
+}  // namespace airi
+}  // namespace crdc
@@ -0,0 +1,68 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: footprint registry. The event names marked on the frames are interned
+//              to small integer ids, so that a frame keeps its footprints in a bitset.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace crdc {
+namespace airi {
+
+using FootprintID = int;
+
+class FootprintRegistry {
+ public:
+  // the number of the footprints kept in the bitset of a frame
+  static const FootprintID kMaxFootprints = 512;
+
+  /**
+   * @brief get the id of the name, a new id is given to a new name.
+   *        Called by EventManager::init for all the events.
+   * @param [in] the name
+   * @return the id, could be >= kMaxFootprints when too many names [FootprintID]
+   */
+  static FootprintID intern(const std::string& name);
+
+  /**
+   * @brief get the id of an interned name. Lock free for the ids < kMaxFootprints,
+   *        the lock is taken only when there are more names.
+   * @return the id, -1 if the name is not interned [FootprintID]
+   */
+  static FootprintID find(const std::string& name);
+
+  /**
+   * @brief get the name of the id, empty if not found
+   */
+  static std::string name(FootprintID id);
+
+ private:
+  // an interned name, never changed nor freed once published
+  struct Entry {
+    std::string name;
+    FootprintID id;
+  };
+
+  // the open addressing table of the ids < kMaxFootprints, half full at most
+  static const size_t kTableSize = 2 * kMaxFootprints;
+
+  static std::mutex& lock();
+  // all the names, taken under the lock
+  static std::unordered_map<std::string, FootprintID>& ids();
+  static std::vector<std::unique_ptr<Entry>>& entries();
+  // the ids < kMaxFootprints, read without lock
+  static std::atomic<const Entry*>* table();
+  static std::atomic<const Entry*>* by_id();
+  // some names are out of the table
+  static std::atomic<bool>& overflow();
+};
+
+}  // namespace airi
+}  // namespace crdc
@@ -13,11 +13,24 @@
 namespace crdc {
 namespace airi {
 
+static Frame::CustomDataSizer& custom_data_sizer() {
+  static Frame::CustomDataSizer sizer;
+  return sizer;
+}
+
 Frame::Frame()
     : frame_type(""),
-      base_frame(new BaseFrame) {}
+      base_frame(new BaseFrame) {
+  for (auto& word : footprint_bits_) {
+    word.store(0, std::memory_order_relaxed);
+  }
+}
 
 Frame::Frame(const Frame& frame) {
+  for (int i = 0; i < kFootprintWords; ++i) {
+    footprint_bits_[i].store(frame.footprint_bits_[i].load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+  }
   {
     std::unique_lock<std::mutex> lock(frame.fp_lock_);
     footprint_ = frame.footprint_;
@@ -25,25 +38,140 @@ Frame::Frame(const Frame& frame) {
   base_frame.reset(new BaseFrame(*frame.base_frame));
   frame_type = frame.frame_type;
   supplement = frame.supplement;
+  if (frame.trace) {
+    trace.reset(new FrameTrace(*frame.trace));
+  }
 }
 
 bool Frame::has_footprint(const std::string& fp) const {
-  std::unique_lock<std::mutex> lock(fp_lock_, std::try_to_lock);
-  if (!lock) {
+  FootprintID id = FootprintRegistry::find(fp);
+  if (id >= 0 && id < FootprintRegistry::kMaxFootprints) {
+    return has_footprint(id);
+  }
+  std::unique_lock<std::mutex> lock(fp_lock_);
+  return footprint_.count(fp);
+}
+
+bool Frame::has_footprint(FootprintID id) const {
+  if (id < 0) {
     return false;
   }
-  bool has = footprint_.count(fp);
-  return has;
+  if (id >= FootprintRegistry::kMaxFootprints) {
+    std::unique_lock<std::mutex> lock(fp_lock_);
+    return footprint_.count(FootprintRegistry::name(id));
+  }
+  return footprint_bits_[id / 64].load(std::memory_order_acquire) & (1ULL << (id % 64));
 }
 
 void Frame::add_footprint(const std::string& fp) const {
+  FootprintID id = FootprintRegistry::find(fp);
+  if (id >= 0 && id < FootprintRegistry::kMaxFootprints) {
+    add_footprint(id);
+    return;
+  }
   std::unique_lock<std::mutex> lock(fp_lock_);
   footprint_.emplace(fp);
 }
 
-std::string Frame::footprints() const {
+void Frame::add_footprint(FootprintID id) const {
+  if (id < 0) {
+    return;
+  }
+  if (id >= FootprintRegistry::kMaxFootprints) {
+    std::unique_lock<std::mutex> lock(fp_lock_);
+    footprint_.emplace(FootprintRegistry::name(id));
+    return;
+  }
+  footprint_bits_[id / 64].fetch_or(1ULL << (id % 64), std::memory_order_acq_rel);
+}
+
+size_t Frame::byte_size() const {
+  size_t bytes = sizeof(Frame) + frame_type.capacity();
+  if (base_frame) {
+    bytes += sizeof(BaseFrame) + base_frame->sender.capacity();
+    if (base_frame->data && custom_data_sizer()) {
+      bytes += custom_data_sizer()(*base_frame->data);
+    }
+  }
+  for (const auto& p : supplement) {
+    bytes += sizeof(p) + p.first.capacity();
+  }
+  if (trace) {
+    bytes += sizeof(FrameTrace);
+  }
   std::unique_lock<std::mutex> lock(fp_lock_);
+  for (const auto& fp : footprint_) {
+    bytes += sizeof(fp) + fp.capacity();
+  }
+  return bytes;
+}
+
+void Frame::charge(size_t bytes, std::atomic<size_t>* account) const {
+  std::unique_lock<std::mutex> lock(charge_lock_);
+  if (holders_.empty()) {
+    charged_bytes_ = bytes;
+    *account += bytes;
+  }
+  holders_.push_back(account);
+}
+
+void Frame::discharge(std::atomic<size_t>* account) const {
+  std::unique_lock<std::mutex> lock(charge_lock_);
+  auto it = std::find(holders_.begin(), holders_.end(), account);
+  if (it == holders_.end()) {
+    return;
+  }
+  const bool charged = it == holders_.begin();
+  holders_.erase(it);
+  if (charged) {
+    *account -= charged_bytes_;
+    if (!holders_.empty()) {
+      *holders_.front() += charged_bytes_;
+    }
+  }
+}
+
+void Frame::set_custom_data_sizer(const CustomDataSizer& sizer) {
+  custom_data_sizer() = sizer;
+}
+
+void Frame::mark_shared(int writers, bool has_readers) const {
+  writers_.store(writers, std::memory_order_relaxed);
+  has_readers_.store(has_readers, std::memory_order_relaxed);
+  shared_.store(true, std::memory_order_release);
+}
+
+bool Frame::try_own() const {
+  if (!shared_.load(std::memory_order_acquire)) {
+    return true;
+  }
+  if (has_readers_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  // the others release after their copy, so the last one could write in place
+  int last = 1;
+  if (writers_.compare_exchange_strong(last, 0, std::memory_order_acq_rel)) {
+    shared_.store(false, std::memory_order_release);
+    return true;
+  }
+  return false;
+}
+
+void Frame::release() const {
+  writers_.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+std::string Frame::footprints() const {
   std::ostringstream fp_ss;
+  for (int i = 0; i < kFootprintWords; ++i) {
+    uint64_t word = footprint_bits_[i].load(std::memory_order_acquire);
+    for (int b = 0; word != 0; ++b, word >>= 1) {
+      if (word & 1) {
+        fp_ss << FootprintRegistry::name(i * 64 + b) << ",";
+      }
+    }
+  }
+  std::unique_lock<std::mutex> lock(fp_lock_);
   std::copy(footprint_.begin(), footprint_.end(), std::ostream_iterator<std::string>(fp_ss, ","));
   return fp_ss.str();
 }
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <functional>
+#include <atomic>
 #include <memory>
 #include <set>
 #include <string>
@@ -14,6 +16,8 @@
 #include <vector>
 #include <mutex>
 #include <boost/any.hpp>
+#include "framework/byte_size.h"
+#include "framework/footprint.h"
 
 namespace crdc {
 namespace airi {
@@ -49,6 +53,133 @@ struct BaseFrame {
   std::shared_ptr<CustomData> data;
 };
 
+/**
+ * @brief the times of the frame at an operator, in microsecond
+ */
+struct TraceHop {
+  // the trigger event of the operator
+  int event_id = 0;
+  // published by the upstream
+  uint64_t enqueue = 0LL;
+  // taken by the operator
+  uint64_t dequeue = 0LL;
+  uint64_t process_start = 0LL;
+  // published by the operator
+  uint64_t process_end = 0LL;
+};
+
+/**
+ * @brief The trace of the frame from its input operator, through each operator it
+ *        triggers. Started by Port::publish of the input operators and aggregated by
+ *        EventManager when the frame leaves the last operator.
+ */
+struct FrameTrace {
+  static const int kMaxHops = 16;
+
+  /**
+   * @brief the frame is taken by the operator of the event
+   */
+  void add_hop(int event_id, uint64_t enqueue, uint64_t dequeue) {
+    if (num_hops >= kMaxHops) {
+      truncated = true;
+      return;
+    }
+    auto& hop = hops[num_hops++];
+    hop.event_id = event_id;
+    hop.enqueue = enqueue;
+    hop.dequeue = dequeue;
+    hop.process_start = 0;
+    hop.process_end = 0;
+  }
+
+  /**
+   * @brief the operator of the last hop starts or ends its processing
+   */
+  void begin(uint64_t now) {
+    if (num_hops > 0 && !truncated) {
+      hops[num_hops - 1].process_start = now;
+    }
+  }
+  void end(uint64_t now) {
+    if (num_hops > 0 && !truncated && hops[num_hops - 1].process_end == 0) {
+      hops[num_hops - 1].process_end = now;
+    }
+  }
+
+  // the received time of the data, or the publish of the input operator
+  uint64_t origin = 0LL;
+  int num_hops = 0;
+  // the frame went through more operators than kMaxHops, e.g. a ring
+  bool truncated = false;
+  TraceHop hops[kMaxHops];
+};
+
+/**
+ * @brief The extra data of the frame by name. The ops of a PARALLEL group write it
+ *        at the same time, so the lookups and the inserts take a lock. The values
+ *        stay where they are, each op could write its own keys through the returned
+ *        reference. The iteration takes no lock, it is used when no op writes.
+ */
+class Supplement {
+ public:
+  using Map = std::unordered_map<std::string, boost::any>;
+
+  Supplement() = default;
+  Supplement(const Supplement& other) {
+    std::unique_lock<std::mutex> lock(other.lock_);
+    map_ = other.map_;
+  }
+  Supplement& operator =(const Supplement& other) {
+    if (this != &other) {
+      Map map;
+      {
+        std::unique_lock<std::mutex> lock(other.lock_);
+        map = other.map_;
+      }
+      std::unique_lock<std::mutex> lock(lock_);
+      map_.swap(map);
+    }
+    return *this;
+  }
+
+  boost::any& operator [](const std::string& key) {
+    std::unique_lock<std::mutex> lock(lock_);
+    return map_[key];
+  }
+  boost::any& at(const std::string& key) {
+    std::unique_lock<std::mutex> lock(lock_);
+    return map_.at(key);
+  }
+  const boost::any& at(const std::string& key) const {
+    std::unique_lock<std::mutex> lock(lock_);
+    return map_.at(key);
+  }
+  size_t count(const std::string& key) const {
+    std::unique_lock<std::mutex> lock(lock_);
+    return map_.count(key);
+  }
+  size_t erase(const std::string& key) {
+    std::unique_lock<std::mutex> lock(lock_);
+    return map_.erase(key);
+  }
+  size_t size() const {
+    std::unique_lock<std::mutex> lock(lock_);
+    return map_.size();
+  }
+  bool empty() const { return size() == 0; }
+  void clear() {
+    std::unique_lock<std::mutex> lock(lock_);
+    map_.clear();
+  }
+
+  Map::const_iterator begin() const { return map_.begin(); }
+  Map::const_iterator end() const { return map_.end(); }
+
+ private:
+  mutable std::mutex lock_;
+  Map map_;
+};
+
 /**
  * @brief The Frame used for transport
  */
@@ -99,6 +230,13 @@ struct Frame {
    */
   bool has_footprint(const std::string& fp) const;
 
+  /**
+   * @brief check the footprint by its id in FootprintRegistry. Lock free.
+   * @param[in] the footprint id [FootprintID]
+   * @return has footprint [bool]
+   */
+  bool has_footprint(FootprintID id) const;
+
   /**
    * @brief Add footprint in the frame. The footprint is added by event in port. And
    *        named by event name.
@@ -106,20 +244,108 @@ struct Frame {
    */
   void add_footprint(const std::string& fp) const;
 
+  /**
+   * @brief Add footprint by its id in FootprintRegistry. Lock free.
+   * @param[in] the footprint id [FootprintID]
+   */
+  void add_footprint(FootprintID id) const;
+
   /**
    * @brief print the footprints
    * @return the string list of the footprints[std::string]
    */
   std::string footprints() const;
+
+  using CustomDataSizer = std::function<size_t(const CustomData&)>;
+
+  /**
+   * @brief the bytes held by the frame, used by the memory budget of the cached data.
+   *        The CustomData is measured by the sizer set by set_custom_data_sizer.
+   * @return the bytes [size_t]
+   */
+  size_t byte_size() const;
+
+  /**
+   * @brief a cache starts holding the frame. Port::publish puts one shared frame in
+   *        several caches, its bytes are charged to one of them at a time.
+   * @param[in] the bytes of the frame
+   * @param[in] the bytes of the cache
+   */
+  void charge(size_t bytes, std::atomic<size_t>* account) const;
+
+  /**
+   * @brief a cache stops holding the frame. The charge moves to the next cache
+   *        holding it, so the bytes are counted as long as any cache holds the frame.
+   * @param[in] the bytes of the cache
+   */
+  void discharge(std::atomic<size_t>* account) const;
+
+  /**
+   * @brief set how to measure the CustomData. Only the shell is counted if not set.
+   *        Should be called before the DAGStreaming starts.
+   * @param[in] the sizer
+   */
+  static void set_custom_data_sizer(const CustomDataSizer& sizer);
+
+  /**
+   * @brief Copy on write. Port::publish puts one frame in all the output caches and
+   *        marks it shared. A consumer must own the frame before writing it.
+   * @param[in] the number of the consumers which get it as trigger and write it
+   * @param[in] whether it is also held by readers (reference data), then no
+   *            consumer could own it
+   */
+  void mark_shared(int writers, bool has_readers) const;
+
+  /**
+   * @brief try to own the frame for writing. It fails if the frame is shared and
+   *        other consumers or readers still hold it, then the consumer should
+   *        copy it and call release().
+   * @return could write in place [bool]
+   */
+  bool try_own() const;
+
+  /**
+   * @brief the consumer has copied the shared frame and does not touch it anymore.
+   */
+  void release() const;
+
+  bool is_shared() const { return shared_.load(std::memory_order_acquire); }
+
   std::string frame_type;
   std::shared_ptr<BaseFrame> base_frame = nullptr;
-  mutable std::unordered_map<std::string, boost::any> supplement;
+  mutable Supplement supplement;
+  // the latency trace, nullptr if it is not traced. Copied with the frame
+  std::unique_ptr<FrameTrace> trace;
 
  private:
   Frame& operator =(const Frame& frame);
+  static const int kFootprintWords = FootprintRegistry::kMaxFootprints / 64;
+  // the footprint history, one bit for each interned id
+  mutable std::atomic<uint64_t> footprint_bits_[kFootprintWords];
   mutable std::mutex fp_lock_;
-  // the footprint history list
+  // the footprints not interned or out of the bitset, rarely used
   mutable std::set<std::string> footprint_;
+  // copy on write state, a copy of the frame is never shared
+  mutable std::atomic<bool> shared_{false};
+  mutable std::atomic<bool> has_readers_{false};
+  mutable std::atomic<int> writers_{0};
+  // the caches holding the frame, the first one is charged. A copy is not held
+  mutable std::mutex charge_lock_;
+  mutable std::vector<std::atomic<size_t>*> holders_;
+  mutable size_t charged_bytes_ = 0;
+};
+
+/**
+ * @brief the caches count the frame once, however many of them hold it
+ */
+template <>
+struct ByteCharge<Frame> {
+  static void charge(const Frame& frame, size_t bytes, std::atomic<size_t>* account) {
+    frame.charge(bytes, account);
+  }
+  static void discharge(const Frame& frame, size_t bytes, std::atomic<size_t>* account) {
+    frame.discharge(account);
+  }
 };
 
 }  // namespace airi
@@ -11,10 +11,14 @@
 #include "framework/event.h"
 #include "framework/event_manager.h"
 #include "framework/event_worker.h"
+#include "framework/work_stealing_pool.h"
 #include "framework/shared_data.h"
 #include "framework/frame.h"
 #include "framework/cached_data.h"
 #include "framework/shared_data_manager.h"
+#include "framework/latency_histogram.h"
+#include "framework/operator_status.h"
+#include "framework/tracer.h"
 #include "framework/operator.h"
 #include "framework/dag_streaming.h"
 #include "framework/dag.h"
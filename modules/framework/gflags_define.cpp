@@ -11,12 +11,21 @@ namespace airi {
 /// used in shared data
 DEFINE_int32(shared_data_stale_time, 2,
              "the time threshold longer than which the data becomes stale, in second");
+DEFINE_int32(shared_data_byte_budget_mb, 0,
+             "the max memory held by all the shared data, in MB. 0 for unlimited");
+DEFINE_int32(shared_data_memory_report_interval, 60,
+             "the interval of the shared data memory report, in second. 0 to disable");
 /// used in cached data
 DEFINE_int32(cached_data_stale_time, 2,
              "the time threshold longer than which the data becomes stale, in second");
 DEFINE_int32(cached_data_tolerate_offset, 5, "tolerate search range");
 DEFINE_int32(cached_data_expire_time, 60,
              "the time threshold longer than which do not need to bundle, in second");
+DEFINE_int32(cached_data_byte_budget_mb, 0,
+             "the default max memory held by each cached data, in MB. 0 for unlimited");
+DEFINE_bool(cached_data_evict_on_put, false,
+            "whether each put removes the stale data of its own cached data. "
+            "If true, enable_timing_remove_stale_data could be turned off");
 
 /// used in dag_streaming
 DEFINE_int32(max_allowed_congestion_value, 0,
@@ -24,9 +33,44 @@ DEFINE_int32(max_allowed_congestion_value, 0,
              "max_allowed_congestion_value, reset DAGStreaming."
              "(default is 0, disable this feature.)");
 DEFINE_bool(enable_timing_remove_stale_data, true, "whether timing clean shared data");
+DEFINE_int32(operator_status_report_interval, 60,
+             "The interval (s) to log the frames and the busy time of the operators, "
+             "0 to disable.");
 
 /// used in event_manager
 DEFINE_int32(max_event_queue_size, 1, "The max size of event queue.");
+DEFINE_int32(event_queue_block_timeout, 1000,
+             "The max time (ms) a publisher waits on a full BLOCK event queue.");
+DEFINE_int32(event_queue_report_interval, 60,
+             "The interval (s) to log the dropped events, 0 to disable.");
+
+/// used in processor and operator
+DEFINE_bool(enable_latency_histogram, false,
+            "Whether to record the time of each op and operator into the histograms.");
+DEFINE_int32(latency_report_interval, 60,
+             "The interval (s) to log the percentiles of the op times, 0 to disable.");
+
+/// used in port
+DEFINE_bool(enable_latency_trace, false,
+            "Whether to trace the frames from the input operators to the end of their "
+            "pipelines, the end to end latency is logged with the op times.");
+
+/// used in tracer
+DEFINE_string(trace_file, "",
+              "The Chrome trace-event JSON file of the spans of the workers, ops and ports, "
+              "written when the DAG exits. Empty to disable the tracer.");
+DEFINE_int32(trace_buffer_size, 65536,
+             "The spans kept by each thread for the tracer, the oldest are overwritten.");
+
+/// used in dag
+DEFINE_bool(enable_operator_fusion, false,
+            "Whether to fuse the linear chains of the operators at link time, "
+            "the fused operator runs on the thread of its upstream.");
+
+/// used in work_stealing_pool
+DEFINE_int32(executor_threads, 0,
+             "The threads of the pool for the operators with `executor: POOL`, "
+             "0 for the number of the cores.");
 
 /// used in framework_main
 DEFINE_string(dag_config_path, "./conf/dag_streaming.config", "Onboard DAG Streaming config.");
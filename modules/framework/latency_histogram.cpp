@@ -0,0 +1,82 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: latency histogram
+
+#include "framework/latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace crdc {
+namespace airi {
+
+LatencyHistogram::LatencyHistogram() {
+  for (auto& count : counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+}
+
+int LatencyHistogram::index(uint64_t value) {
+  if (value < static_cast<uint64_t>(kSubBuckets)) {
+    return static_cast<int>(value);
+  }
+  // the top kSubBits bits under the highest one choose the sub bucket
+  int shift = 63 - __builtin_clzll(value) - kSubBits;
+  return (shift + 1) * kSubBuckets + static_cast<int>((value >> shift) & (kSubBuckets - 1));
+}
+
+uint64_t LatencyHistogram::highest(int index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  int shift = index / kSubBuckets - 1;
+  uint64_t lowest = static_cast<uint64_t>(kSubBuckets + index % kSubBuckets) << shift;
+  return lowest + ((1ULL << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t value) {
+  counts_[index(value)].fetch_add(1, std::memory_order_relaxed);
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t LatencyHistogram::count() const {
+  uint64_t count = 0;
+  for (auto& c : counts_) {
+    count += c.load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+  uint64_t total = count();
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(std::ceil(total * std::min(p, 100.0) / 100.0));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    seen += counts_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      return std::min(highest(i), max());
+    }
+  }
+  return max();
+}
+
+std::string LatencyHistogram::to_string() const {
+  auto us = [](uint64_t ns) { return ns / 1000.0; };
+  std::ostringstream oss;
+  oss << std::fixed << std::setprecision(1) << "count: " << count()
+      << " p50: " << us(percentile(50)) << " p90: " << us(percentile(90))
+      << " p99: " << us(percentile(99)) << " max: " << us(max()) << " us";
+  return oss.str();
+}
+
+}  // namespace airi
+}  // namespace crdc
@@ -0,0 +1,72 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: latency histogram. A lock free log-linear histogram as HDR, which the
+//              workers record the time of the ops into on each frame, and the monitor
+//              reads the percentiles from.
+
+#pragma once
+
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace crdc {
+namespace airi {
+
+DECLARE_bool(enable_latency_histogram);
+DECLARE_int32(latency_report_interval);
+
+class LatencyHistogram {
+ public:
+  // the sub buckets of each power of 2, the error of a value is within 1/16
+  static const int kSubBits = 4;
+  static const int kSubBuckets = 1 << kSubBits;
+  // the linear buckets under kSubBuckets, then one row for each highest bit
+  // from kSubBits to 63, the last index is 975 for the values >= 2^63
+  static const int kBuckets = (65 - kSubBits) * kSubBuckets;
+
+  LatencyHistogram();
+
+  /**
+   * @brief the time to record, in ns of the steady clock
+   */
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /**
+   * @brief record a value, lock free
+   * @param [in] the time in ns
+   */
+  void record(uint64_t value);
+
+  uint64_t count() const;
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief the value at the percentile, the highest value of its bucket
+   * @param [in] the percentile, (0, 100]
+   * @return the time in ns, 0 if nothing recorded
+   */
+  uint64_t percentile(double p) const;
+
+  /**
+   * @brief count p50 p90 p99 max in us
+   */
+  std::string to_string() const;
+
+ private:
+  static int index(uint64_t value);
+  static uint64_t highest(int index);
+
+  // a single add on each record, the count is summed when read
+  std::atomic<uint64_t> counts_[kBuckets];
+  std::atomic<uint64_t> max_{0};
+};
+
+}  // namespace airi
+}  // namespace crdc
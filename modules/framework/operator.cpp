@@ -4,6 +4,7 @@
 // Description: Operator
 
 #include "framework/operator.h"
+#include "framework/work_stealing_pool.h"
 
 namespace crdc {
 namespace airi {
@@ -17,9 +18,44 @@ std::ostream& operator<<(std::ostream& os, const Operator& op) {
 
 Operator::Operator() : stop_(true) {}
 
+static int to_sched_policy(OperatorConfig::SchedPolicy policy) {
+  switch (policy) {
+    case OperatorConfig::FIFO:
+      return SCHED_FIFO;
+    case OperatorConfig::RR:
+      return SCHED_RR;
+    default:
+      return SCHED_OTHER;
+  }
+}
+
+bool Operator::waits_in_worker() const {
+  if (config_.dependency_size() > 0) {
+    return true;
+  }
+  for (int i = 0; i < config_.input_wait_size(); ++i) {
+    if (config_.input_wait(i) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Operator::hands_over_blocking() const {
+  return config_.replicas() > 1 ||
+         (config_.has_group() && config_.group().processor() == OpGroupConfig::PIPELINE);
+}
+
 bool Operator::init_workers() {
   int worker_size = config_.trigger_size();
   workers_.resize(worker_size);
+  std::vector<int> cpus(config_.cpu_affinity().begin(), config_.cpu_affinity().end());
+  if (cpus.empty() && config_.isolated_cpu()) {
+    cpus = crdc::airi::common::Thread::isolated_cpus();
+    if (cpus.empty()) {
+      LOG(WARNING) << *this << " no isolated cpu in the system, runs on all the cpus.";
+    }
+  }
   for (int i = 0; i < worker_size; ++i) {
     workers_[i].reset(new EventWorker(shared_from_this(), i));
     if (config_.has_priority()) {
@@ -27,13 +63,70 @@ bool Operator::init_workers() {
       LOG(INFO) << "Operator: " << name_ << ", id: " << i
             << ", priority: " << workers_[i]->get_priority();
     }
+    workers_[i]->set_cpu_affinity(cpus);
+    workers_[i]->set_sched_policy(to_sched_policy(config_.sched_policy()),
+                                  config_.rt_priority());
+    if (config_.executor() == OperatorConfig::THREAD) {
+      continue;
+    }
+    // the input operator is woken by its source, not by the events
+    if (is_input_ || !sub_meta_events_[i]) {
+      LOG(WARNING) << *this << " trigger [" << i << "] has no event, runs in a thread.";
+      continue;
+    }
+    // the upstream would run the triggers of one operator at the same time
+    if (config_.executor() == OperatorConfig::INLINE && worker_size > 1) {
+      LOG(WARNING) << *this << " INLINE needs a single trigger, runs in a thread.";
+      continue;
+    }
+    // a waiting trigger would park a thread of the pool with the tasks behind it,
+    // or the publishing thread of the upstream
+    if (waits_in_worker()) {
+      LOG(WARNING) << *this << " waits for the dependencies or the inputs, runs in a thread.";
+      continue;
+    }
+    // the stage and the replica channels block the hand-over when they are full
+    if (config_.executor() == OperatorConfig::POOL && hands_over_blocking()) {
+      LOG(WARNING) << *this << " hands the frames over to its own threads, runs in a thread.";
+      continue;
+    }
+    // an inlined trigger has no event queue to apply the policy to
+    if (config_.executor() == OperatorConfig::INLINE && config_.trigger_queue_policy_size() > 0) {
+      LOG(WARNING) << *this << " INLINE has no trigger queue policy, runs in a thread.";
+      continue;
+    }
+    if (!cpus.empty() || config_.sched_policy() != OperatorConfig::OTHER) {
+      LOG(WARNING) << *this << " the placement is ignored by executor "
+                   << OperatorConfig::Executor_Name(config_.executor()) << ".";
+    }
+    auto worker = workers_[i];
+    if (config_.executor() == OperatorConfig::INLINE) {
+      worker->set_inlined(true);
+      ports_[i].set_inline_callback(
+          [worker](const Event& event, const std::shared_ptr<Frame>& frame) {
+            worker->run_inline(event, frame);
+          });
+      LOG(INFO) << "Operator: " << name_ << ", id: " << i << " runs on its upstream";
+      continue;
+    }
+    workers_[i]->set_pooled(true);
+    ports_[i].set_event_callback([worker] { worker->schedule(); });
+    LOG(INFO) << "Operator: " << name_ << ", id: " << i << " runs in WorkStealingPool";
   }
-  is_running_.assign(worker_size, false);
-  start_time_.assign(worker_size, 0);
-
   return true;
 }
 
+static std::shared_ptr<framework::Processor> create_processor(const OpGroupConfig& group) {
+  switch (group.processor()) {
+    case OpGroupConfig::PARALLEL:
+      return std::make_shared<framework::ParallelProcessor>();
+    case OpGroupConfig::PIPELINE:
+      return std::make_shared<framework::PipelineProcessor>();
+    default:
+      return std::make_shared<framework::SeqProcessor>();
+  }
+}
+
 static bool to_group_config(const OperatorConfig& config, OpGroupConfig* group) {
   if (!config.has_algorithm()) {
     return false;
@@ -123,7 +216,17 @@ bool Operator::init(const OperatorID id, const OperatorConfig& config, EventMana
     return false;
   }
 
-  processor_.reset(new framework::SeqProcessor);
+  if (config_.replicas() > 1) {
+    std::vector<std::shared_ptr<framework::Processor>> replicas;
+    for (int i = 0; i < config_.replicas(); ++i) {
+      replicas.emplace_back(create_processor(group));
+    }
+    processor_.reset(new framework::ReplicaProcessor(
+        replicas, config_.replica_dispatch(), config_.replica_lateness() * 1000ULL));
+  } else {
+    processor_ = create_processor(group);
+  }
+  processor_->set_priority(config_.priority());
 
   CHECK_GT(config_.trigger_size(), 0);
   cv_.resize(config_.trigger_size());
@@ -167,6 +270,10 @@ bool Operator::init(const OperatorID id, const OperatorConfig& config, EventMana
     output_data_name_[i] = ports_[i].output_data_name();
     output_event_name_[i] = ports_[i].output_event_name();
     perf_string_[i] = "Operator<" + algorithm_ + "> get_input_data [" + std::to_string(i) + "]";
+    if (FLAGS_enable_latency_histogram) {
+      input_latency_.emplace_back(new LatencyHistogram);
+      process_latency_.emplace_back(new LatencyHistogram);
+    }
   }
   input_data_name_ = ports_[0].input_data_name();
   input_event_name_ = ports_[0].input_event_name();
@@ -194,12 +301,11 @@ bool Operator::init(const OperatorID id, const OperatorConfig& config, EventMana
 
   print_events();
 
-  if (!shared_data_manager_->register_cached_data(name_, "OperatorInfoCachedData")) {
-    LOG(ERROR) << "Failed to register OperatorInfoCachedData for [" << name_ << "]";
+  status_ = crdc::airi::common::Singleton<OperatorStatusBoard>::get()->get(id_);
+  if (!status_) {
+    LOG(ERROR) << "No status of " << *this << " on the OperatorStatusBoard";
     return false;
   }
-  info_data_ =
-      dynamic_cast<OperatorInfoCachedData*>(shared_data_manager_->get_shared_data(name_));
 
   inited_ = true;
   stop_ = false;
@@ -208,7 +314,11 @@ bool Operator::init(const OperatorID id, const OperatorConfig& config, EventMana
 
 void Operator::join() {
   for (auto& worker : workers_) {
-    if (worker->is_alive()) {
+    if (worker->is_pooled()) {
+      worker->wait_task();
+    } else if (worker->is_inlined()) {
+      worker->wait_inline();
+    } else if (worker->is_alive()) {
       worker->join();
     }
     LOG(INFO) << "EventWorker[" << worker->name() << "] joined successfully";
@@ -238,7 +348,7 @@ void Operator::stop() {
     event.event_id = sub->event_id;
     event.timestamp = 0;
     event.reserve = "";
-    event_manager_->publish(event);
+    event_manager_->publish(event, true);
   }
 }
 
@@ -251,102 +361,79 @@ bool Operator::bypass() {
 }
 
 void Operator::init_dependency_info() {
-  deps_info_data_.resize((config_.dependency()).size());
-  for (int i = 0; i < (config_.dependency()).size(); ++i) {
+  auto board = crdc::airi::common::Singleton<OperatorStatusBoard>::get();
+  deps_status_.resize(config_.dependency_size());
+  for (int i = 0; i < config_.dependency_size(); ++i) {
     auto& op_dep = config_.dependency(i);
     LOG(INFO) << "op_dep.name: " << op_dep.name();
-    deps_info_data_.at(i) = (dynamic_cast<OperatorInfoCachedData*>(
-                                        shared_data_manager_->get_shared_data(op_dep.name())));
-    if (!deps_info_data_[i]) {
+    deps_status_[i] = board->find(op_dep.name());
+    if (!deps_status_[i]) {
       LOG(WARNING) << "Failed to get dep info: " << op_dep.name();
     }
   }
 }
 
-bool Operator::process_denpendency(std::shared_ptr<Frame>* trigger, bool& is_block) {
-  uint64_t wait_time = 0;
+void Operator::process_denpendencies(std::shared_ptr<Frame>* trigger) {
+  // the longest time a frame waits for the dependencies running
+  static const uint64_t kMaxDependencyWait = 100000;
   uint64_t now = get_now_microsecond();
-  is_block = true;
-  for (size_t i = 0; i < deps_info_data_.size(); ++i) {
-    if (deps_info_data_[i]) {
-      std::shared_ptr<const OperatorInfo> info = nullptr;
-      if (deps_info_data_[i]->get_newest(&info) && info) {
-        auto& op_dep = config_.dependency(i);
-        uint64_t op_wait_time = (uint64_t)op_dep.wait_time() * 1000;
-        int64_t time_diff;
-        switch (op_dep.policy()) {
-          case OperatorDependency_DependencyPolicy_WAIT:
-            if (info->is_running && (info->start_running_time + op_wait_time > now)) {
-              wait_time = std::max(info->start_running_time + op_wait_time - now, (uint64_t)1000);
-            }
-            break;
-          case OperatorDependency_DependencyPolicy_BLOCK:
-            if (info->is_running) {
-              wait_time = std::max(op_wait_time, (uint64_t)5000);
-              is_block = true;
-            }
-            break;
-          case OperatorDependency_DependencyPolicy_BUNDLE:
-            time_diff = (int64_t)now - (int64_t)(*trigger)->base_frame->utime;
-            if (std::abs(time_diff) < static_cast<int64_t>(op_wait_time)) {
-              wait_time = std::max(op_wait_time - time_diff, (uint64_t)1000);
-            }
-            break;
-          default:
-            LOG(ERROR) << "Now not support policy: "
-                  << OperatorDependency_DependencyPolicy_Name(op_dep.policy());
-            break;
+  uint64_t max_deadline = now + kMaxDependencyWait;
+  uint64_t bundle_deadline = 0;
+  bool waited = false;
+  for (size_t i = 0; i < deps_status_.size(); ++i) {
+    if (!deps_status_[i]) {
+      continue;
+    }
+    auto& op_dep = config_.dependency(i);
+    uint64_t op_wait_time = (uint64_t)op_dep.wait_time() * 1000;
+    uint64_t running_since = deps_status_[i]->running_since();
+    uint64_t deadline = 0;
+    int64_t time_diff;
+    switch (op_dep.policy()) {
+      case OperatorDependency_DependencyPolicy_WAIT:
+        // the dependency started within the wait time is waited until it finishes
+        if (running_since != 0 && running_since + op_wait_time > now) {
+          deadline = std::min(running_since + op_wait_time, max_deadline);
         }
-      }
+        break;
+      case OperatorDependency_DependencyPolicy_BLOCK:
+        if (running_since != 0) {
+          deadline = max_deadline;
+        }
+        break;
+      case OperatorDependency_DependencyPolicy_BUNDLE:
+        // the frames within the wait time of the trigger, no matter the dependency
+        time_diff = (int64_t)now - (int64_t)(*trigger)->base_frame->utime;
+        if (std::abs(time_diff) < static_cast<int64_t>(op_wait_time)) {
+          bundle_deadline = std::max(bundle_deadline, now + op_wait_time - time_diff);
+        }
+        break;
+      default:
+        LOG(ERROR) << "Now not support policy: "
+              << OperatorDependency_DependencyPolicy_Name(op_dep.policy());
+        break;
+    }
+    if (deadline > 0) {
+      deps_status_[i]->wait_finish(deadline);
+      waited = true;
     }
   }
-  if (wait_time > 0) {
-    LOG(INFO) << "process_denpendency " << name_ << " wait: " << wait_time << " us";
-    std::this_thread::sleep_for(std::chrono::microseconds(wait_time));
+  if (bundle_deadline > get_now_microsecond()) {
+    std::this_thread::sleep_for(
+        std::chrono::microseconds(bundle_deadline - get_now_microsecond()));
+    waited = true;
   }
-  return wait_time > 0;
-}
-
-void Operator::process_denpendencies(std::shared_ptr<Frame>* trigger) {
-  bool retry = true;
-  int process_cnt = 0;
-  uint64_t now = get_now_microsecond();
-  while (retry) {
-    bool is_block;
-    retry = false;
-    if (process_denpendency(trigger, is_block)) {
-      if (is_block) {
-        retry = static_cast<bool>(get_now_microsecond() - now <
-                                    100000);
-      } else {
-        retry = static_cast<bool>(process_cnt < 1);
-      }
-    }
-    ++process_cnt;
+  if (waited) {
+    LOG(INFO) << "process_denpendency " << name_ << " wait: " << get_now_microsecond() - now
+              << " us";
   }
 }
 
-void Operator::update_info(int idx, bool running) {
-  uint64_t now = get_now_microsecond();
-  is_running_[idx] = running;
+void Operator::update_info(bool running, uint64_t begin) {
   if (running) {
-    start_time_[idx] = now;
-  }
-
-  std::shared_ptr<OperatorInfo> info = std::make_shared<OperatorInfo>();
-  if (!inited_ || bypass()) {
-    info->is_running = false;
+    status_->start(begin);
   } else {
-    info->start_running_time = now;
-    for (size_t i = 0; i < is_running_.size(); i++) {
-      if (is_running_[i]) {
-        info->start_running_time = std::min(info->start_running_time, start_time_[i]);
-        info->is_running = true;
-      }
-    }
-  }
-  if (!info_data_->put(now, info)) {
-    LOG(ERROR) << "Fail to put data: " << name_;
+    status_->finish(begin, get_now_microsecond());
   }
 }
 
@@ -372,19 +459,55 @@ Status Operator::process_and_publish(int idx, std::shared_ptr<Frame>& trigger, b
   Status ret = Status::SUCC;
   if (!bypass()) {
     process_denpendencies(&trigger);
-    update_info(idx, true);
-    if (!port.get_input_data(trigger->base_frame->utime, &frames)) {
+    const uint64_t begin = get_now_microsecond();
+    update_info(true, begin);
+    const bool timed = !input_latency_.empty();
+    uint64_t start = timed ? LatencyHistogram::now() : 0;
+    bool has_input = port.get_input_data(trigger->base_frame->utime, &frames);
+    if (timed) {
+      record_latency(&input_latency_, idx, start);
+      start = LatencyHistogram::now();
+    }
+    if (trigger->trace) {
+      trigger->trace->begin(get_now_microsecond());
+    }
+    if (!has_input) {
       ret = Status::FAIL;
     } else if (is_peek) {
       ret = processor_->peek(idx, frames, trigger);
       latests.resize(port.latest_event_name().size(), nullptr);
+      if (timed) {
+        record_latency(&process_latency_, idx, start);
+      }
     } else {
       if (!port.get_latest_data(trigger->base_frame->utime, &latests)) {
         LOG(ERROR) << *this << " Failed to get latests data";
       }
+      if (processor_->is_async()) {
+        // the processor publishes the frames in order when they finish, the frame
+        // is running until its done callback, which could be on another thread
+        ret = processor_->process_async(idx, frames, latests, trigger,
+            [this, idx, begin, start, timed](Status status, std::shared_ptr<Frame>& data) {
+              if (timed) {
+                record_latency(&process_latency_, idx, start);
+              }
+              update_info(false, begin);
+              if (status == Status::SUCC || status == Status::IGNORE) {
+                ports_[idx].publish(data);
+              }
+            });
+        if (ret == Status::FAIL) {
+          // not taken, the done callback is never called
+          update_info(false, begin);
+        }
+        return ret;
+      }
       ret = processor_->process(idx, frames, latests, trigger);
+      if (timed) {
+        record_latency(&process_latency_, idx, start);
+      }
     }
-    update_info(idx, false);
+    update_info(false, begin);
   }
 
   if (ret == Status::SUCC || ret == Status::IGNORE) {
@@ -394,6 +517,34 @@ Status Operator::process_and_publish(int idx, std::shared_ptr<Frame>& trigger, b
   return ret;
 }
 
+void Operator::record_latency(std::vector<std::unique_ptr<LatencyHistogram>>* latency, int idx,
+                              uint64_t start) {
+  if (static_cast<size_t>(idx) < latency->size()) {
+    (*latency)[idx]->record(LatencyHistogram::now() - start);
+  }
+}
+
+std::string Operator::latency_report() const {
+  std::ostringstream oss;
+  oss << "Latency of " << *this << ":" << std::endl;
+  for (size_t i = 0; i < input_latency_.size(); ++i) {
+    oss << "    * " << perf_string_[i] << " " << input_latency_[i]->to_string() << std::endl;
+    oss << "    * Operator<" << algorithm_ << "> process [" << i << "] "
+        << process_latency_[i]->to_string() << std::endl;
+  }
+  oss << processor_->latency_summary();
+  return oss.str();
+}
+
+Status Operator::proc_inline(int idx, const Event& event, const std::shared_ptr<Frame>& frame,
+                             bool is_peek) {
+  std::shared_ptr<Frame> trigger;
+  if (!ports_[idx].get_trigger_data(event, frame, &trigger)) {
+    return Status::FAIL;
+  }
+  return process_and_publish(idx, trigger, is_peek);
+}
+
 Status Operator::peek_event(int idx) {
   LOG(INFO) << *this << " peek event";
   return process_and_publish(idx, true);
@@ -422,13 +573,19 @@ void Operator::run() {
   init_dependency_info();
 
   for (auto& worker : workers_) {
-    worker->start();
+    if (worker->is_pooled()) {
+      crdc::airi::common::Singleton<WorkStealingPool>::get()->start(FLAGS_executor_threads);
+      worker->start_pooled();
+    } else if (worker->is_inlined()) {
+      worker->start_inlined();
+    } else {
+      worker->start();
+    }
   }
 }
 
 void Operator::publish(int idx, std::shared_ptr<Frame>& trigger) { ports_[idx].publish(trigger); }
 
 REGISTER_OPERATOR(Operator);
-REGISTER_SHARED_DATA(OperatorInfoCachedData);
 }  // namespace airi
 }  // namespace crdc
@@ -15,6 +15,7 @@
 #include "framework/cached_data.h"
 #include "framework/event_manager.h"
 #include "framework/event_worker.h"
+#include "framework/operator_status.h"
 #include "framework/shared_data_manager.h"
 #include "framework/port.h"
 #include "framework/processor.h"
@@ -23,23 +24,6 @@
 namespace crdc {
 namespace airi {
 
-struct OperatorInfo {
-  OperatorInfo() = default;
-  bool is_running = false;
-  uint64_t start_running_time = 0;
-};
-
-class OperatorInfoCachedData : public CachedData<OperatorInfo> {
- public:
-  OperatorInfoCachedData() : CachedData<OperatorInfo>(0) {}
-  virtual ~OperatorInfoCachedData() = default;
-
-  std::string name() const override { return "OperatorInfoCachedData"; }
-
- private:
-  DISALLOW_COPY_AND_ASSIGN(OperatorInfoCachedData);
-};
-
 class Operator : public ParamManager, public std::enable_shared_from_this<Operator> {
  public:
   Operator();
@@ -60,6 +44,16 @@ class Operator : public ParamManager, public std::enable_shared_from_this<Operat
   virtual Status peek_event(int idx);
   virtual Status proc_events(int idx);
 
+  /**
+   * @brief process the frame published by the upstream on its thread, for INLINE
+   * @param [in] the trigger index
+   * @param [in] the event, which is not queued
+   * @param [in] the published frame
+   * @param [in] whether it is the first event, which is peeked
+   */
+  Status proc_inline(int idx, const Event& event, const std::shared_ptr<Frame>& frame,
+                     bool is_peek);
+
   void wait(int idx) {
     CHECK(is_input_);
     std::unique_lock<std::mutex> lock(*mutex_[idx].get());
@@ -71,8 +65,19 @@ class Operator : public ParamManager, public std::enable_shared_from_this<Operat
     cv_[idx]->notify_one();
   }
 
+  /**
+   * @brief whether an event is waiting for the idx-th trigger
+   */
+  bool has_event(int idx) const { return ports_[idx].has_event(); }
+
   const std::vector<std::shared_ptr<EventWorker>>& workers() const { return workers_; }
 
+  /**
+   * @brief the percentiles of the time of get_input_data and the processor of each
+   *        trigger, and of each op of the processor
+   */
+  std::string latency_report() const;
+
   friend std::ostream& operator<<(std::ostream& os, const Operator& op);
 
  protected:
@@ -96,18 +101,42 @@ class Operator : public ParamManager, public std::enable_shared_from_this<Operat
 
   bool init_workers();
 
+  /**
+   * @brief whether a frame could wait for the dependencies or the inputs
+   */
+  bool waits_in_worker() const;
+
+  /**
+   * @brief whether the processor hands the frames over to its stages or replicas,
+   *        waiting for the room of their channels
+   */
+  bool hands_over_blocking() const;
+
   bool init_group(OpGroupConfig& group);
 
-  void update_info(int idx, bool running);
+  /**
+   * @brief start or finish a frame on the status board
+   * @param [in] true to start
+   * @param [in] the start time of the frame, us as get_now_microsecond()
+   */
+  void update_info(bool running, uint64_t begin);
 
   void init_dependency_info();
 
-  bool process_denpendency(std::shared_ptr<Frame>* trigger, bool& is_block);
-
+  /**
+   * @brief wait for the dependencies before the frame, WAIT and BLOCK resume when
+   *        the dependency finishes, BUNDLE waits for the frames around the trigger.
+   */
   void process_denpendencies(std::shared_ptr<Frame>* trigger);
 
   void print_events();
 
+  /**
+   * @brief record the time since the start into the histogram of the idx-th trigger
+   */
+  void record_latency(std::vector<std::unique_ptr<LatencyHistogram>>* latency, int idx,
+                      uint64_t start);
+
   Status process_and_publish(int idx, bool is_peek);
   Status process_and_publish(int idx, std::shared_ptr<Frame>& trigger, bool is_peek);
   OpType type_;
@@ -137,12 +166,12 @@ class Operator : public ParamManager, public std::enable_shared_from_this<Operat
   std::vector<std::vector<std::string>> output_data_name_;
 
   std::vector<std::string> perf_string_;
+  // the time of get_input_data and the processor of each trigger, empty if disabled
+  std::vector<std::unique_ptr<LatencyHistogram>> input_latency_;
+  std::vector<std::unique_ptr<LatencyHistogram>> process_latency_;
 
-  std::vector<bool> is_running_;
-  std::vector<uint64_t> start_time_;
-
-  OperatorInfoCachedData* info_data_ = nullptr;
-  std::vector<OperatorInfoCachedData *> deps_info_data_;
+  OperatorStatus* status_ = nullptr;
+  std::vector<OperatorStatus*> deps_status_;
   std::vector<FrameCachedData *> deps_data_;
 
   size_t skip_latest_cnt_ = 0;
@@ -0,0 +1,113 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: operator status board
+
+#include "framework/operator_status.h"
+
+namespace crdc {
+namespace airi {
+
+void OperatorStatus::start(uint64_t now) {
+  if (running_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+    running_since_.store(now, std::memory_order_release);
+  }
+}
+
+void OperatorStatus::finish(uint64_t start, uint64_t now) {
+  uint64_t elapsed = now > start ? now - start : 0;
+  busy_time_.fetch_add(elapsed, std::memory_order_relaxed);
+  uint64_t max_time = max_time_.load(std::memory_order_relaxed);
+  while (elapsed > max_time &&
+         !max_time_.compare_exchange_weak(max_time, elapsed, std::memory_order_relaxed)) {
+  }
+  last_finish_.store(now, std::memory_order_relaxed);
+  frames_.fetch_add(1, std::memory_order_seq_cst);
+  running_.fetch_sub(1, std::memory_order_seq_cst);
+  // pairs with the waiters_ increment in wait_finish(), either the waiter sees
+  // the finish or it is seen waiting here
+  if (waiters_.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard<std::mutex> lock(lock_);
+    cv_.notify_all();
+  }
+}
+
+bool OperatorStatus::wait_finish(uint64_t deadline) {
+  uint64_t frames = frames_.load(std::memory_order_seq_cst);
+  if (!is_running()) {
+    return true;
+  }
+  std::unique_lock<std::mutex> lock(lock_);
+  waiters_.fetch_add(1, std::memory_order_seq_cst);
+  bool done = true;
+  while (running_.load(std::memory_order_seq_cst) != 0 &&
+         frames_.load(std::memory_order_seq_cst) == frames) {
+    uint64_t now = get_now_microsecond();
+    if (now >= deadline) {
+      done = false;
+      break;
+    }
+    cv_.wait_for(lock, std::chrono::microseconds(deadline - now));
+  }
+  waiters_.fetch_sub(1, std::memory_order_relaxed);
+  return done;
+}
+
+bool OperatorStatusBoard::init(const std::vector<std::string>& names) {
+  size_ = names.size();
+  status_.reset(new OperatorStatus[size_]);
+  names_ = names;
+  ids_.clear();
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (!ids_.emplace(names[i], static_cast<OperatorID>(i)).second) {
+      LOG(ERROR) << "OperatorStatusBoard: duplicate operator name: " << names[i];
+      return false;
+    }
+  }
+  Snapshot start;
+  start.time = get_now_microsecond();
+  last_report_.assign(size_, start);
+  return true;
+}
+
+OperatorStatus* OperatorStatusBoard::get(OperatorID id) {
+  if (id < 0 || static_cast<size_t>(id) >= size_) {
+    return nullptr;
+  }
+  return &status_[id];
+}
+
+OperatorStatus* OperatorStatusBoard::find(const std::string& name) {
+  auto iter = ids_.find(name);
+  if (iter == ids_.end()) {
+    return nullptr;
+  }
+  return get(iter->second);
+}
+
+std::string OperatorStatusBoard::report() {
+  std::ostringstream oss;
+  oss << "Operator status:" << std::endl;
+  uint64_t now = get_now_microsecond();
+  for (size_t i = 0; i < size_; ++i) {
+    auto& status = status_[i];
+    auto& last = last_report_[i];
+    Snapshot snapshot;
+    snapshot.time = now;
+    snapshot.frames = status.frames();
+    snapshot.busy_time = status.busy_time();
+    uint64_t frames = snapshot.frames - last.frames;
+    uint64_t busy_time = snapshot.busy_time - last.busy_time;
+    uint64_t period = now > last.time ? now - last.time : 0;
+    oss << "    * " << names_[i] << " frames: " << frames
+        << " avg: " << (frames > 0 ? busy_time / frames : 0) << " us"
+        << " max: " << status.max_time() << " us"
+        << " busy: " << (period > 0 ? busy_time * 100 / period : 0) << "%"
+        << (status.is_running() ? " (running)" : "") << std::endl;
+    last = snapshot;
+  }
+  return oss.str();
+}
+
+}  // namespace airi
+}  // namespace crdc
@@ -0,0 +1,126 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: operator status board. A fixed array of the running state of each
+//              operator indexed by OperatorID. The workers update it with atomics on
+//              each frame, the dependent operators block on it until the dependency
+//              finishes, and the monitor reads its counters.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common/common.h"
+#include "framework/event.h"
+
+namespace crdc {
+namespace airi {
+
+class alignas(64) OperatorStatus {
+ public:
+  OperatorStatus() = default;
+  // the board allocates the array of the status by new[]
+  ALIGNED_NEW(64);
+
+  /**
+   * @brief a frame starts. The frames of an async processor overlap, so the
+   *        operator runs while any of them is in flight.
+   * @param [in] the start time, us as get_now_microsecond()
+   */
+  void start(uint64_t now);
+
+  /**
+   * @brief a frame finishes, called from the done callback for an async processor.
+   *        The waiters are woken.
+   * @param [in] the start time of the frame
+   * @param [in] the finish time, us as get_now_microsecond()
+   */
+  void finish(uint64_t start, uint64_t now);
+
+  /**
+   * @brief block until the operator finishes a frame or the deadline
+   * @param [in] the deadline, us as get_now_microsecond()
+   * @return false if it is still running at the deadline
+   */
+  bool wait_finish(uint64_t deadline);
+
+  bool is_running() const { return running_.load(std::memory_order_acquire) != 0; }
+  /**
+   * @brief the start time (us) of the running period, since no frame was in flight.
+   *        0 if it is not running.
+   */
+  uint64_t running_since() const {
+    return is_running() ? running_since_.load(std::memory_order_acquire) : 0;
+  }
+  /**
+   * @brief the frames in flight
+   */
+  uint64_t running() const { return running_.load(std::memory_order_acquire); }
+  uint64_t last_finish() const { return last_finish_.load(std::memory_order_relaxed); }
+  uint64_t frames() const { return frames_.load(std::memory_order_acquire); }
+  uint64_t busy_time() const { return busy_time_.load(std::memory_order_relaxed); }
+  uint64_t max_time() const { return max_time_.load(std::memory_order_relaxed); }
+
+ private:
+  // written on each frame
+  std::atomic<uint64_t> running_{0};
+  std::atomic<uint64_t> running_since_{0};
+  std::atomic<uint64_t> last_finish_{0};
+  std::atomic<uint64_t> frames_{0};
+  std::atomic<uint64_t> busy_time_{0};
+  std::atomic<uint64_t> max_time_{0};
+  std::atomic<int> waiters_{0};
+  // only taken when a dependent waits
+  std::mutex lock_;
+  std::condition_variable cv_;
+
+  DISALLOW_COPY_AND_ASSIGN(OperatorStatus);
+};
+
+class OperatorStatusBoard {
+ public:
+  OperatorStatusBoard() = default;
+
+  /**
+   * @brief create the status of the operators, called by DAGStreaming before
+   *        the operators are initialized.
+   * @param [in] the operator names, indexed by OperatorID
+   */
+  bool init(const std::vector<std::string>& names);
+
+  /**
+   * @brief the status of the operator, nullptr if not found
+   */
+  OperatorStatus* get(OperatorID id);
+  OperatorStatus* find(const std::string& name);
+
+  /**
+   * @brief the frames, the average time and the busy ratio of each operator
+   *        since the last report, with the max time since the start
+   */
+  std::string report();
+
+ private:
+  struct Snapshot {
+    uint64_t time = 0;
+    uint64_t frames = 0;
+    uint64_t busy_time = 0;
+  };
+
+  std::unique_ptr<OperatorStatus[]> status_;
+  size_t size_ = 0;
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, OperatorID> ids_;
+  std::vector<Snapshot> last_report_;
+
+  friend class crdc::airi::common::Singleton<OperatorStatusBoard>;
+  DISALLOW_COPY_AND_ASSIGN(OperatorStatusBoard);
+};
+
+}  // namespace airi
+}  // namespace crdc
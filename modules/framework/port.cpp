@@ -10,6 +10,7 @@ namespace airi {
 
 DECLARE_int32(cached_data_expire_time);
 DECLARE_int32(cached_data_tolerate_offset);
+DECLARE_bool(enable_latency_trace);
 
 std::ostream& operator<<(std::ostream& os, const Port& port) {
   os << port.name();
@@ -36,8 +37,34 @@ bool Port::init(const size_t idx, const OperatorConfig& config, EventManager* ev
   if (sub_event) {
     sub_meta_event_.reset(new EventMeta(*sub_event));
     is_input_ = false;
+    trigger_fused_ = config_.fused();
+    sub_queue_ = event_manager_->get_event_queue(sub_event->event_id);
+    if (!sub_queue_) {
+      LOG(ERROR) << "Failed to get the queue of trigger event for Port:" << name();
+      return false;
+    }
   }
   pub_meta_events_ = pub_events;
+  tracer_ = crdc::airi::common::Singleton<Tracer>::get();
+  trace_input_ = tracer_->intern(name_ + " input");
+  trace_publish_ = tracer_->intern(name_ + " publish");
+  if (sub_event) {
+    trace_sub_event_ = tracer_->intern(sub_event->name);
+  }
+  trace_pub_events_.clear();
+  for (const auto& pub_event : pub_meta_events_) {
+    trace_pub_events_.emplace_back(tracer_->intern(pub_event.name));
+  }
+  pub_queues_.clear();
+  for (const auto& pub_event : pub_meta_events_) {
+    pub_queues_.emplace_back(event_manager_->get_event_queue(pub_event.event_id));
+    if (!pub_queues_.back()) {
+      LOG(ERROR) << "Failed to get the queue of output event for Port:" << name();
+      return false;
+    }
+  }
+  inlines_.clear();
+  inlines_.reserve(pub_queues_.size());
 
   if (!init_trigger_data()) {
     LOG(ERROR) << "Failed to init trigger data for Port:" << name();
@@ -47,6 +74,8 @@ bool Port::init(const size_t idx, const OperatorConfig& config, EventManager* ev
     LOG(ERROR) << "Failed to init output data for Port:" << name();
     return false;
   }
+  // interned by EventManager::init already, except the empty one
+  output_footprint_ = FootprintRegistry::intern(output_event_name_);
 
   if (!init_input_data(event_data_map)) {
     LOG(ERROR) << "Failed to init input data for Port:" << name();
@@ -226,6 +255,7 @@ bool Port::init_output_data() {
 
       output_copy_idx_.emplace_back(0);
       output_nocopy_idx_.clear();
+      output_fused_.emplace_back(false);
     } else {
       has_downstream_ = false;
     }
@@ -238,10 +268,12 @@ bool Port::init_output_data() {
   output_event_name_ = output.event();
   output_data_.assign(output.downstream_size(), nullptr);
   output_data_name_.assign(output.downstream_size(), "");
+  output_fused_.assign(output.downstream_size(), false);
   for (int j = 0; j < output.downstream_size(); ++j) {
     auto& downstream = output.downstream(j);
     auto data_name = downstream.data();
     output_data_name_[j] = data_name;
+    output_fused_[j] = downstream.fused();
     FrameCachedData* data =
         dynamic_cast<FrameCachedData*>(shared_data_manager_->get_shared_data(data_name));
     if (data == nullptr) {
@@ -300,22 +332,27 @@ bool Port::get_trigger_data(std::shared_ptr<Frame>* trigger, Event* sub_event) {
   }
   const EventMeta& event_meta = *sub_meta_event_;
 
-  if (!event_manager_->subscribe(event_meta.event_id, sub_event)) {
-    LOG(ERROR) << "Failed to subscribe. meta_event: <" << event_meta.to_string() << ">";
-    return false;
-  }
+  event_manager_->subscribe(sub_queue_, sub_event);
   if (sub_event->timestamp == 0) {
     LOG(ERROR) << "sub event timestamp is 0. meta_event: <" << event_meta.to_string() << ">";
     return false;
   }
 
-  uint64_t timestamp = sub_event->timestamp;
-
-  if (!trigger_data_->get(timestamp, trigger, 0)) {
+  if (!trigger_data_->get(sub_event->timestamp, trigger, 0)) {
     LOG(ERROR) << "Failed to get trigger data:" << trigger_data_name_;
     return false;
   }
+  return take_trigger_data(*sub_event, trigger);
+}
 
+bool Port::get_trigger_data(const Event& sub_event, const std::shared_ptr<Frame>& frame,
+                            std::shared_ptr<Frame>* trigger) {
+  *trigger = frame;
+  return take_trigger_data(sub_event, trigger);
+}
+
+bool Port::take_trigger_data(const Event& sub_event, std::shared_ptr<Frame>* trigger) {
+  uint64_t timestamp = sub_event.timestamp;
   if (timestamp != (*trigger)->base_frame->utime) {
     LOG(ERROR) << "Failed to get trigger data:" << trigger_data_name_
                << "event timestamp: " << timestamp << ", data utime: "
@@ -323,9 +360,25 @@ bool Port::get_trigger_data(std::shared_ptr<Frame>* trigger, Event* sub_event) {
     return false;
   }
 
+  // copy on write. The frame shared with other caches is copied before writing,
+  // and the copy goes back to the cache for the nocopy consumers after this one.
+  if (!(*trigger)->try_own()) {
+    std::shared_ptr<Frame> own(new Frame(**trigger));
+    (*trigger)->release();
+    if (!trigger_fused_ && !output_nocopy_idx_.empty() &&
+        !trigger_data_->replace(timestamp, own)) {
+      LOG(ERROR) << *this << " Failed to replace trigger data:" << trigger_data_name_;
+    }
+    *trigger = own;
+  }
+
   uint64_t now = get_now_microsecond();
-  if (sub_event->local_timestamp > 0) {
-    int dt = now - sub_event->local_timestamp;
+  if ((*trigger)->trace) {
+    (*trigger)->trace->add_hop(sub_event.event_id, sub_event.local_timestamp, now);
+  }
+  tracer_->flow(trace_sub_event_, Tracer::flow_id(sub_event.event_id, timestamp), false);
+  if (sub_event.local_timestamp > 0) {
+    int dt = now - sub_event.local_timestamp;
     LOG(INFO) << *this << " FetchData: " << dt << " us";
   }
 
@@ -361,6 +414,8 @@ bool Port::get_input_data(const std::vector<uint64_t>& timestamps,
 }
 
 bool Port::get_input_data(uint64_t timestamp, std::vector<std::shared_ptr<const Frame>>* frames) {
+  // the waits of the inputs are the gaps between the spans of the operator
+  TraceSpan span(trace_input_, timestamp);
   frames->resize(input_data_.size());
   for (size_t i = 0; i < input_data_.size(); ++i) {
     CHECK(input_data_[i]);
@@ -375,8 +430,6 @@ bool Port::get_input_data(uint64_t timestamp, std::vector<std::shared_ptr<const
       frames->at(i) = input_data;
       data_found = true;
     }
-    // check every 5ms
-    static const int check_dt = 2000;
     static const uint64_t max_expire_time = FLAGS_cached_data_expire_time * 1000000;
     if (!data_found && input_wait_[i] > 0) {
       const uint64_t expired_time = timestamp - max_expire_time;
@@ -384,18 +437,15 @@ bool Port::get_input_data(uint64_t timestamp, std::vector<std::shared_ptr<const
       if (input_data_[i]->get_newest(input_ptr) &&
                 (*input_ptr)->base_frame->utime > expired_time) {
         std::shared_ptr<Frame> input_data;
-        int trail = input_wait_[i] / check_dt + 1;
-        for (int t = 0; t < trail; ++t) {
-          LOG(WARNING) << *this << " input frame data:[" << input_event_name_[i] << "]"
-                       << " try to fetch in " << check_dt << " us";
-          std::this_thread::sleep_for(std::chrono::microseconds(static_cast<uint64_t>(check_dt)));
-          if (input_data_[i]->get(tstamp, &input_data, input_window_[i])) {
-            LOG(INFO) << *this << " input frame data:[" << input_event_name_[i] << "]"
-                  << " input data found in " << (t + 1) * check_dt << " us";
-            data_found = true;
-            frames->at(i) = input_data;
-            break;
-          }
+        LOG(WARNING) << *this << " input frame data:[" << input_event_name_[i] << "]"
+                     << " wait for " << input_wait_[i] << " us";
+        // woken up by the put of the input
+        const uint64_t wait_begin = get_now_microsecond();
+        if (input_data_[i]->wait_for(tstamp, &input_data, input_window_[i], input_wait_[i])) {
+          LOG(INFO) << *this << " input frame data:[" << input_event_name_[i] << "]"
+                << " input data found in " << get_now_microsecond() - wait_begin << " us";
+          data_found = true;
+          frames->at(i) = input_data;
         }
       } else {
         LOG(WARNING) << *this << " input frame data:[" << input_event_name_[i]
@@ -463,18 +513,55 @@ bool Port::get_latest_data(const std::vector<uint64_t>& timestamps,
   return true;
 }
 
+bool Port::set_event_callback(std::function<void()> callback) {
+  if (!sub_queue_) {
+    return false;
+  }
+  event_manager_->set_publish_callback(sub_queue_, std::move(callback));
+  return true;
+}
+
+bool Port::set_inline_callback(EventManager::InlineCallback callback) {
+  if (!sub_queue_) {
+    return false;
+  }
+  event_manager_->set_inline_callback(sub_queue_, std::move(callback));
+  return true;
+}
+
 void Port::publish(const std::shared_ptr<Frame>& trigger) {
   const std::vector<EventMeta>& pub_meta_events = pub_meta_events_;
   const std::vector<int>& copy_idx = output_copy_idx_;
   const std::vector<int>& nocopy_idx = output_nocopy_idx_;
 
   auto ts = trigger->base_frame->utime;
+  TraceSpan span(trace_publish_, ts);
 
-  trigger->add_footprint(output_event_name_);
+  trigger->add_footprint(output_footprint_);
   uint64_t now = get_now_microsecond();
+  // the trace starts at the input operators and goes with the copies of the frame
+  if (is_input_ && !trigger->trace && FLAGS_enable_latency_trace) {
+    trigger->trace.reset(new FrameTrace);
+    trigger->trace->origin = trigger->base_frame->recv_utime > 0 ?
+                             trigger->base_frame->recv_utime : now;
+  }
+  if (trigger->trace) {
+    trigger->trace->end(now);
+    if (!has_downstream_) {
+      event_manager_->record_trace(*trigger->trace, now);
+    }
+  }
+  // copy on write. The reference data and the copy outputs share one frame, the
+  // consumers copy it only if they could not own it, see get_trigger_data. The
+  // bytes of the frame are charged to one cache at a time, see Frame::charge.
+  std::shared_ptr<Frame> shared;
+  int writers = has_downstream_ ? copy_idx.size() : 0;
+  if (ref_data_ || writers > 0) {
+    shared.reset(new Frame(*trigger));
+    shared->mark_shared(writers, ref_data_ != nullptr);
+  }
   if (ref_data_) {
-    std::shared_ptr<Frame> data(new Frame(*trigger));
-    if (!ref_data_->put(ts, data)) {
+    if (!ref_data_->put(ts, shared)) {
       LOG(ERROR) << *this << " Failed to PUT reference data: " << ref_data_name_;
     } else {
       LOG(INFO) << *this << " PUT reference data: " << ref_data_name_ << " utime:" << ts;
@@ -483,15 +570,22 @@ void Port::publish(const std::shared_ptr<Frame>& trigger) {
   if (!has_downstream_) {
     return;
   }
+  std::vector<std::tuple<int, Event, std::shared_ptr<Frame>>> reentered;
+  auto& inlines = publishing_ ? reentered : inlines_;
+  const bool reused = !publishing_;
+  publishing_ = true;
   for (auto& i : copy_idx) {
     if (ts > output_last_[i]
         && ((ts - output_last_[i]) < output_period_[i])) {
       LOG(ERROR) << *this << " skip to put data: " << output_data_name_[i];
+      shared->release();
       continue;
     }
-    std::shared_ptr<Frame> data(new Frame(*trigger));
-    if (!output_data_[i]->put(ts, data)) {
+    // the fused downstream takes the frame from here, nobody else reads the data
+    bool fused = output_fused_[i] && pub_queues_[i]->on_inline;
+    if (!fused && !output_data_[i]->put(ts, shared)) {
       LOG(ERROR) << *this << " Failed to put data: " << output_data_name_[i];
+      shared->release();
       continue;
     }
     if (output_event_name_.empty()) {
@@ -502,7 +596,12 @@ void Port::publish(const std::shared_ptr<Frame>& trigger) {
       event.event_id = pub_meta_events[i].event_id;
       event.timestamp = ts;
       event.local_timestamp = now;
-      this->event_manager_->publish(event);
+      tracer_->flow(trace_pub_events_[i], Tracer::flow_id(event.event_id, ts), true);
+      if (pub_queues_[i]->on_inline) {
+        inlines.emplace_back(i, event, shared);
+      } else {
+        this->event_manager_->publish(pub_queues_[i], event);
+      }
       LOG(INFO) << *this << " publish event(with data[" << output_data_name_[i]
           << "]): " << pub_meta_events[i].name;
     }
@@ -514,15 +613,34 @@ void Port::publish(const std::shared_ptr<Frame>& trigger) {
       LOG(ERROR) << *this << " skip to put data: " << output_data_name_[i];
       continue;
     }
+    // the fused trigger skipped the cached data, which the queued downstream reads
+    if (trigger_fused_ && !pub_queues_.at(i)->on_inline && !output_data_[i]->put(ts, trigger)) {
+      LOG(ERROR) << *this << " Failed to put data: " << output_data_name_[i];
+      continue;
+    }
     Event event;
     event.event_id = pub_meta_events.at(i).event_id;
     event.timestamp = ts;
     event.local_timestamp = now;
-    this->event_manager_->publish(event);
+    tracer_->flow(trace_pub_events_[i], Tracer::flow_id(event.event_id, ts), true);
+    if (pub_queues_.at(i)->on_inline) {
+      inlines.emplace_back(i, event, trigger);
+    } else {
+      this->event_manager_->publish(pub_queues_.at(i), event);
+    }
     LOG(INFO) << *this << " publish event ([" << output_data_name_[i]
           << "]): " << pub_meta_events[i].name;
     output_last_[i] = ts;
   }
+  // the INLINE downstreams run after all the outputs are published, as if they
+  // were woken up by the events
+  for (auto& item : inlines) {
+    pub_queues_[std::get<0>(item)]->on_inline(std::get<1>(item), std::get<2>(item));
+  }
+  if (reused) {
+    inlines.clear();
+    publishing_ = false;
+  }
 }
 
 }  // namespace airi
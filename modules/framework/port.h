@@ -5,9 +5,11 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 #include <algorithm>
@@ -15,6 +17,7 @@
 #include "framework/cached_data.h"
 #include "framework/event_manager.h"
 #include "framework/shared_data_manager.h"
+#include "framework/tracer.h"
 #include "framework/proto/dag_config.pb.h"
 
 namespace crdc {
@@ -50,6 +53,9 @@ class Port {
    * @brief data getter of each type data
    */
   bool get_trigger_data(std::shared_ptr<Frame>* trigger, Event* sub_event);
+  // the trigger handed over by the publisher, for the INLINE operators
+  bool get_trigger_data(const Event& sub_event, const std::shared_ptr<Frame>& frame,
+                        std::shared_ptr<Frame>* trigger);
   bool get_latest_data(uint64_t timestamp, std::vector<std::shared_ptr<const Frame>>* latests);
   bool get_latest_data(const std::vector<uint64_t>& timestamp,
                             std::vector<std::shared_ptr<const Frame>>* latests);
@@ -57,6 +63,25 @@ class Port {
   bool get_input_data(const std::vector<uint64_t>& timestamp,
                             std::vector<std::shared_ptr<const Frame>>* frames);
 
+  /**
+   * @brief whether an event is waiting in the trigger event queue
+   */
+  bool has_event() const { return sub_queue_ && !sub_queue_->channel.empty(); }
+
+  /**
+   * @brief call the callback after each event published to the trigger event queue,
+   *        instead of blocking on the queue. Used by the pooled workers.
+   * @return false if the port has no trigger event
+   */
+  bool set_event_callback(std::function<void()> callback);
+
+  /**
+   * @brief run the callback on the thread of the publisher with the published frame,
+   *        instead of the trigger event queue. Used by the INLINE operators.
+   * @return false if the port has no trigger event
+   */
+  bool set_inline_callback(EventManager::InlineCallback callback);
+
   /**
    * @brief publish the trigger Frame. Gives the timestamp, footprint of the data.
    * @param trigger Frame
@@ -75,6 +100,11 @@ class Port {
   bool init_input_data(const std::map<std::string, std::string>& event_data_map);
   bool init_latest_data(const std::map<std::string, std::string>& event_data_map);
 
+  /**
+   * @brief check the trigger of the event and own it, copy on write
+   */
+  bool take_trigger_data(const Event& sub_event, std::shared_ptr<Frame>* trigger);
+
   size_t idx_ = 0;
   bool is_input_ = false;
   std::string name_;
@@ -89,21 +119,32 @@ class Port {
 
   std::shared_ptr<EventMeta> sub_meta_event_ = nullptr;
   std::vector<EventMeta> pub_meta_events_;
+  // the event queues, resolved by init
+  EventManager::EventQueue* sub_queue_ = nullptr;
+  std::vector<EventManager::EventQueue*> pub_queues_;
 
   // trigger data variable
   std::string trigger_data_name_;
   std::string trigger_event_name_;
   FrameCachedData* trigger_data_ = nullptr;
+  // fused into the upstream, the trigger is handed over without the cached data
+  bool trigger_fused_ = false;
 
   // output data variable
   bool has_downstream_ = false;
   std::string output_event_name_;
+  // the INLINE downstreams of a publish, reserved for all the outputs by init. A
+  // publish entered again from an INLINE downstream, e.g. in a loop, uses its own
+  std::vector<std::tuple<int, Event, std::shared_ptr<Frame>>> inlines_;
+  bool publishing_ = false;
+  FootprintID output_footprint_ = -1;
   std::vector<std::string> output_data_name_;
   std::vector<FrameCachedData*> output_data_;
   std::vector<unsigned int> output_period_;
   std::vector<uint64_t> output_last_;
   std::vector<int> output_copy_idx_;
   std::vector<int> output_nocopy_idx_;
+  std::vector<bool> output_fused_;
 
   // input data variable
   std::vector<int> input_wait_;
@@ -120,6 +161,13 @@ class Port {
   std::vector<int> latest_tolerate_offset_;
 
   uint64_t last_ts_ = 0;
+
+  // the span and flow names in the tracer
+  Tracer* tracer_ = nullptr;
+  int trace_input_ = 0;
+  int trace_publish_ = 0;
+  int trace_sub_event_ = 0;
+  std::vector<int> trace_pub_events_;
 };
 
 std::ostream& operator<<(std::ostream& os, const Port& port);
@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include "framework/processor.h"
+#include "framework/work_stealing_pool.h"
 
 namespace crdc {
 namespace airi {
@@ -114,6 +115,34 @@ void Processor::init_perf_string(const OpGroupConfig& config) {
       perf_string_[i][j] = config.op(j).algorithm();
     }
   }
+  trace_name_.clear();
+  for (size_t j = 0; j < ops_.size(); ++j) {
+    trace_name_.emplace_back(
+        crdc::airi::common::Singleton<Tracer>::get()->intern(config.op(j).algorithm()));
+  }
+  if (!FLAGS_enable_latency_histogram) {
+    return;
+  }
+  latency_.resize(trigger_event_name_.size());
+  for (auto& latency : latency_) {
+    for (size_t j = 0; j < ops_.size(); ++j) {
+      latency.emplace_back(std::make_shared<LatencyHistogram>());
+    }
+  }
+}
+
+std::string Processor::latency_summary() const {
+  std::ostringstream oss;
+  for (size_t i = 0; i < latency_.size(); ++i) {
+    for (size_t j = 0; j < latency_[i].size(); ++j) {
+      if (latency_[i][j]->count() == 0) {
+        continue;
+      }
+      oss << "    * Op" << j << "<" << perf_string_[i][j] << "> [" << i << "] "
+          << latency_[i][j]->to_string() << std::endl;
+    }
+  }
+  return oss.str();
 }
 
 bool SeqProcessor::init(const OpGroupConfig& group) {
@@ -151,8 +180,9 @@ bool SeqProcessor::init(const OpGroupConfig& group) {
 Status SeqProcessor::peek(const int& idx, const std::vector<std::shared_ptr<const Frame>>& frames,
                           std::shared_ptr<Frame>& data) {
   Status ret = Status::SUCC;
+  uint64_t start = latency_start();
   for (const auto& i : valid_) {
-    ret = ops_[i]->peek(idx, frames, data);
+    ret = run_op(idx, i, data, &start, [&] { return ops_[i]->peek(idx, frames, data); });
     if (ignore_fail_ || ret == Status::SUCC || ret == Status::IGNORE) {
       continue;
     }
@@ -167,8 +197,11 @@ Status SeqProcessor::process(const int& idx,
                              const std::vector<std::shared_ptr<const Frame>>& latests,
                              std::shared_ptr<Frame>& data) {
   Status ret = Status::SUCC;
+  uint64_t start = latency_start();
   for (const auto& i : valid_) {
-    ret = ops_[i]->process(idx, frames, latests, data);
+    ret = run_op(idx, i, data, &start, [&] {
+      return ops_[i]->process(idx, frames, latests, data);
+    });
     if (ret != Status::SUCC && !ignore_fail_) {
       LOG(ERROR) << *ops_[i] << " process failed";
       return ret;
@@ -177,6 +210,638 @@ Status SeqProcessor::process(const int& idx,
   return ret;
 }
 
+bool ParallelProcessor::init(const OpGroupConfig& group) {
+  config_ = group;
+  if (config_.op_size() == 0) {
+    return false;
+  }
+  name_ = config_.op(0).algorithm();
+  ops_.resize(config_.op_size());
+  for (int i = 0; i < config_.op_size(); ++i) {
+    auto alg = config_.op(i).algorithm();
+    ops_[i] = OpFactory::get(alg);
+    if (!ops_[i]) {
+      return false;
+    }
+  }
+  if (!io_sanity_check(ops_.front(), ops_.back())) {
+    return false;
+  }
+  ignore_fail_ = config_.parallel_config().ignore_fail();
+  for (int i = 0; i < config_.op_size(); ++i) {
+    if (config_.op(i).bypass()) {
+      continue;
+    }
+    valid_.emplace_back(i);
+    if (!init_op(config_.op(i), &ops_[i])) {
+      return false;
+    }
+  }
+  if (!init_depends()) {
+    return false;
+  }
+  init_perf_string(config_);
+  crdc::airi::common::Singleton<WorkStealingPool>::get()->start(FLAGS_executor_threads);
+  LOG(INFO) << "ParallelProcessor: " << *this << " initailized";
+  return true;
+}
+
+bool ParallelProcessor::init_depends() {
+  std::unordered_map<std::string, int> index;
+  for (int i = 0; i < config_.op_size(); ++i) {
+    if (!index.emplace(config_.op(i).algorithm(), i).second) {
+      LOG(ERROR) << "ParallelProcessor: " << *this << " duplicate algorithm in group: "
+                 << config_.op(i).algorithm();
+      return false;
+    }
+  }
+  downstreams_.assign(config_.op_size(), {});
+  num_depends_.assign(config_.op_size(), 0);
+  for (const auto& i : valid_) {
+    for (const auto& depend : config_.op(i).depend()) {
+      auto iter = index.find(depend);
+      if (iter == index.end()) {
+        LOG(ERROR) << "ParallelProcessor: " << *this << " " << config_.op(i).algorithm()
+                   << " depends on unknown op: " << depend;
+        return false;
+      }
+      // the bypassed op is done already
+      if (config_.op(iter->second).bypass()) {
+        continue;
+      }
+      downstreams_[iter->second].emplace_back(i);
+      ++num_depends_[i];
+    }
+  }
+
+  // check the loop as DAG::sort_and_check_has_loop
+  std::vector<int> depends = num_depends_;
+  std::vector<int> ready;
+  for (const auto& i : valid_) {
+    if (depends[i] == 0) {
+      ready.emplace_back(i);
+    }
+  }
+  size_t count = 0;
+  while (!ready.empty()) {
+    int i = ready.back();
+    ready.pop_back();
+    ++count;
+    for (const auto& d : downstreams_[i]) {
+      if (--depends[d] == 0) {
+        ready.emplace_back(d);
+      }
+    }
+  }
+  if (count != valid_.size()) {
+    LOG(ERROR) << "ParallelProcessor: " << *this << " Loop Detected in depend";
+    return false;
+  }
+  return true;
+}
+
+Status ParallelProcessor::run(bool is_peek, std::function<Status(int)> call) {
+  if (valid_.empty()) {
+    return Status::SUCC;
+  }
+  std::shared_ptr<Run> run = std::make_shared<Run>();
+  run->call = std::move(call);
+  run->is_peek = is_peek;
+  run->depends = num_depends_;
+  run->status.assign(ops_.size(), Status::SUCC);
+  for (const auto& i : valid_) {
+    if (num_depends_[i] == 0) {
+      run->ready.emplace_back(i);
+    }
+  }
+  execute(run, false);
+
+  if (run->failed != Status::SUCC) {
+    return run->failed;
+  }
+  if (ignore_fail_ && !is_peek) {
+    // the status of the last op, as SeqProcessor
+    return run->status[valid_.back()];
+  }
+  return Status::SUCC;
+}
+
+void ParallelProcessor::execute(const std::shared_ptr<Run>& run, bool is_helper) {
+  std::unique_lock<std::mutex> lock(run->lock);
+  if (is_helper) {
+    --run->queued;
+  }
+  while (true) {
+    if (!run->ready.empty() && run->failed == Status::SUCC) {
+      int i = run->ready.front();
+      run->ready.pop_front();
+      ++run->running;
+      // the other ready ops go to the pool, the caller takes them back if the pool is busy
+      while (run->queued < run->ready.size()) {
+        ++run->queued;
+        crdc::airi::common::Singleton<WorkStealingPool>::get()->submit(
+            priority_, [this, run] { execute(run, true); });
+      }
+      lock.unlock();
+      Status ret = run->call(i);
+      lock.lock();
+      --run->running;
+      ++run->finished;
+      run->status[i] = ret;
+      bool ok = ret == Status::SUCC || (run->is_peek && ret == Status::IGNORE);
+      if (!ok && !ignore_fail_) {
+        LOG(ERROR) << "ParallelProcessor: " << *ops_[i] << " process failed";
+        run->failed = ret;
+      }
+      for (const auto& d : downstreams_[i]) {
+        if (--run->depends[d] == 0) {
+          run->ready.emplace_back(d);
+        }
+      }
+      run->cv.notify_all();
+      continue;
+    }
+    if (is_helper) {
+      return;
+    }
+    // the ops taken by the helpers are running, never waits for a queued task
+    if (run->running == 0 && (run->failed != Status::SUCC || run->ready.empty())) {
+      return;
+    }
+    run->cv.wait(lock);
+  }
+}
+
+Status ParallelProcessor::peek(const int& idx,
+                               const std::vector<std::shared_ptr<const Frame>>& frames,
+                               std::shared_ptr<Frame>& data) {
+  return run(true, [&](int i) {
+    uint64_t start = latency_start();
+    return run_op(idx, i, data, &start, [&] { return ops_[i]->peek(idx, frames, data); });
+  });
+}
+
+Status ParallelProcessor::process(const int& idx,
+                                  const std::vector<std::shared_ptr<const Frame>>& frames,
+                                  const std::vector<std::shared_ptr<const Frame>>& latests,
+                                  std::shared_ptr<Frame>& data) {
+  return run(false, [&](int i) {
+    uint64_t start = latency_start();
+    return run_op(idx, i, data, &start, [&] {
+      return ops_[i]->process(idx, frames, latests, data);
+    });
+  });
+}
+
+PipelineProcessor::~PipelineProcessor() { stop(); }
+
+bool PipelineProcessor::init(const OpGroupConfig& group) {
+  config_ = group;
+  if (config_.op_size() == 0) {
+    return false;
+  }
+  name_ = config_.op(0).algorithm();
+  ops_.resize(config_.op_size());
+  for (int i = 0; i < config_.op_size(); ++i) {
+    auto alg = config_.op(i).algorithm();
+    ops_[i] = OpFactory::get(alg);
+    if (!ops_[i]) {
+      return false;
+    }
+  }
+  if (!io_sanity_check(ops_.front(), ops_.back())) {
+    return false;
+  }
+  ignore_fail_ = config_.pipeline_config().ignore_fail();
+  for (int i = 0; i < config_.op_size(); ++i) {
+    if (config_.op(i).bypass()) {
+      continue;
+    }
+    valid_.emplace_back(i);
+    if (!init_op(config_.op(i), &ops_[i])) {
+      return false;
+    }
+  }
+  init_perf_string(config_);
+
+  size_t queue_size = std::max(1, config_.pipeline_config().queue_size());
+  for (size_t k = 0; k < valid_.size(); ++k) {
+    stages_.emplace_back(new Stage(this, k, queue_size));
+    std::string thread_name = config_.op(valid_[k]).algorithm();
+    if (thread_name.length() > 12) {
+      thread_name = thread_name.substr(0, 11);
+    }
+    stages_[k]->set_thread_name(thread_name + "S" + std::to_string(k));
+    stages_[k]->set_priority(priority_);
+  }
+  for (auto& stage : stages_) {
+    stage->start();
+  }
+  LOG(INFO) << "PipelineProcessor: " << *this << " initailized with " << stages_.size()
+            << " stages";
+  return true;
+}
+
+void PipelineProcessor::stop() {
+  if (!stop_.exchange(true)) {
+    // wake the stages, the jobs taken out to make room are dropped
+    Job job;
+    job.stop = true;
+    for (auto& stage : stages_) {
+      Job queued;
+      while (!stage->channel.try_push(job)) {
+        if (stage->channel.try_pop(&queued)) {
+          drop(&queued);
+        }
+      }
+    }
+    for (auto& stage : stages_) {
+      stage->join();
+    }
+    LOG(INFO) << "PipelineProcessor: " << *this << " stopped";
+  }
+  // the frames not finished are dropped, their callers are told
+  Job job;
+  for (auto& stage : stages_) {
+    while (stage->channel.try_pop(&job)) {
+      drop(&job);
+    }
+  }
+  // no stage runs the ops anymore
+  Processor::stop();
+}
+
+void PipelineProcessor::drop(Job* job) {
+  if (!job->stop && job->done) {
+    job->done(Status::FAIL, job->data);
+  }
+  *job = Job();
+}
+
+bool PipelineProcessor::hand_over(JobChannel* channel, const Job& job) {
+  static const int64_t kWaitUs = 100000;
+  while (!channel->push(job, kWaitUs)) {
+    if (stop_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PipelineProcessor::run_stage(size_t k) {
+  const bool is_last = k + 1 == stages_.size();
+  const int i = valid_[k];
+  auto& op = ops_[i];
+  Job job;
+  while (!stop_) {
+    stages_[k]->channel.pop(&job);
+    if (job.stop) {
+      break;
+    }
+    // the failed frame goes through without running, as SeqProcessor returns
+    if (job.status == Status::SUCC || ignore_fail_) {
+      uint64_t start = latency_start();
+      job.status = run_op(job.idx, i, job.data, &start, [&] {
+        return op->process(job.idx, job.frames, job.latests, job.data);
+      });
+      if (job.status != Status::SUCC && !ignore_fail_) {
+        LOG(ERROR) << *op << " process failed";
+      }
+    }
+    if (is_last) {
+      job.done(job.status, job.data);
+    } else if (!hand_over(&stages_[k + 1]->channel, job)) {
+      drop(&job);
+      break;
+    }
+    job = Job();
+  }
+}
+
+Status PipelineProcessor::peek(const int& idx,
+                               const std::vector<std::shared_ptr<const Frame>>& frames,
+                               std::shared_ptr<Frame>& data) {
+  // the first frame, no frame is in the stages yet
+  uint64_t start = latency_start();
+  for (const auto& i : valid_) {
+    Status ret = run_op(idx, i, data, &start, [&] { return ops_[i]->peek(idx, frames, data); });
+    if (ignore_fail_ || ret == Status::SUCC || ret == Status::IGNORE) {
+      continue;
+    }
+    LOG(ERROR) << "PipelineProcessor: " << *this << " process failed";
+    return ret;
+  }
+  return Status::SUCC;
+}
+
+Status PipelineProcessor::process(const int& idx,
+                                  const std::vector<std::shared_ptr<const Frame>>& frames,
+                                  const std::vector<std::shared_ptr<const Frame>>& latests,
+                                  std::shared_ptr<Frame>& data) {
+  // the synchronous call waits for the frame to go through the stages. The state
+  // is shared with the last stage, which may finish after a stop.
+  struct Result {
+    std::mutex lock;
+    std::condition_variable cv;
+    bool finished = false;
+    Status status = Status::SUCC;
+    std::shared_ptr<Frame> data;
+  };
+  auto result = std::make_shared<Result>();
+  Status taken = process_async(idx, frames, latests, data,
+                               [result](Status status, std::shared_ptr<Frame>& frame) {
+    std::lock_guard<std::mutex> guard(result->lock);
+    result->status = status;
+    result->data = frame;
+    result->finished = true;
+    result->cv.notify_one();
+  });
+  if (taken != Status::SUCC) {
+    return taken;
+  }
+  std::unique_lock<std::mutex> guard(result->lock);
+  while (!result->finished) {
+    if (stop_) {
+      return Status::FAIL;
+    }
+    result->cv.wait_for(guard, std::chrono::milliseconds(100));
+  }
+  data = result->data;
+  return result->status;
+}
+
+Status PipelineProcessor::process_async(const int& idx,
+                                        const std::vector<std::shared_ptr<const Frame>>& frames,
+                                        const std::vector<std::shared_ptr<const Frame>>& latests,
+                                        std::shared_ptr<Frame>& data, Done done) {
+  if (stages_.empty()) {
+    done(Status::SUCC, data);
+    return Status::SUCC;
+  }
+  if (stop_) {
+    return Status::FAIL;
+  }
+  Job job;
+  job.idx = idx;
+  job.frames = frames;
+  job.latests = latests;
+  job.data = data;
+  job.done = std::move(done);
+  if (!hand_over(&stages_.front()->channel, job)) {
+    return Status::FAIL;
+  }
+  return Status::SUCC;
+}
+
+ReplicaProcessor::ReplicaProcessor(const std::vector<std::shared_ptr<Processor>>& replicas,
+                                   OperatorConfig::ReplicaDispatch dispatch,
+                                   uint64_t max_lateness)
+    : dispatch_(dispatch), max_lateness_(max_lateness) {
+  for (size_t k = 0; k < replicas.size(); ++k) {
+    replicas_.emplace_back(new Replica(this, k, replicas[k]));
+  }
+}
+
+ReplicaProcessor::~ReplicaProcessor() { stop(); }
+
+bool ReplicaProcessor::init(const OpGroupConfig& group) {
+  if (group.op_size() == 0 || replicas_.empty()) {
+    return false;
+  }
+  name_ = group.op(0).algorithm();
+  for (size_t k = 0; k < replicas_.size(); ++k) {
+    auto& processor = replicas_[k]->processor;
+    processor->set_name(name_);
+    processor->set_input_event_name(input_event_name_);
+    processor->set_output_event_name(output_event_name_);
+    processor->set_latest_event_name(latest_event_name_);
+    processor->set_trigger_event_name(trigger_event_name_);
+    processor->set_trigger_data_name(trigger_data_name_);
+    processor->set_priority(priority_);
+    if (!processor->init(group)) {
+      LOG(ERROR) << "ReplicaProcessor: " << *this << " failed to init replica " << k;
+      return false;
+    }
+    std::string thread_name = name_;
+    if (thread_name.length() > 12) {
+      thread_name = thread_name.substr(0, 11);
+    }
+    replicas_[k]->set_thread_name(thread_name + "R" + std::to_string(k));
+    replicas_[k]->set_priority(priority_);
+  }
+  // the replicas record the op times into the same histograms
+  auto& first = replicas_.front()->processor;
+  first->share_latency(this);
+  for (size_t k = 1; k < replicas_.size(); ++k) {
+    first->share_latency(replicas_[k]->processor.get());
+  }
+  for (auto& replica : replicas_) {
+    replica->start();
+  }
+  LOG(INFO) << "ReplicaProcessor: " << *this << " initailized with " << replicas_.size()
+            << " replicas";
+  return true;
+}
+
+void ReplicaProcessor::stop() {
+  for (auto& replica : replicas_) {
+    replica->processor->stop();
+  }
+  if (stop_.exchange(true)) {
+    return;
+  }
+  // the frames not finished are dropped
+  Job job;
+  job.stop = true;
+  for (auto& replica : replicas_) {
+    replica->channel.push_overwrite(job);
+  }
+  for (auto& replica : replicas_) {
+    replica->join();
+  }
+  LOG(INFO) << "ReplicaProcessor: " << *this << " stopped. dropped: " << dropped();
+}
+
+Status ReplicaProcessor::peek(const int& idx,
+                              const std::vector<std::shared_ptr<const Frame>>& frames,
+                              std::shared_ptr<Frame>& data) {
+  // the first frame, no frame is in the replicas yet
+  replicas_.front()->peeked = true;
+  return replicas_.front()->processor->peek(idx, frames, data);
+}
+
+Status ReplicaProcessor::process(const int& idx,
+                                 const std::vector<std::shared_ptr<const Frame>>& frames,
+                                 const std::vector<std::shared_ptr<const Frame>>& latests,
+                                 std::shared_ptr<Frame>& data) {
+  // the synchronous call waits for its frame, the state is shared with the replica
+  struct Sync {
+    std::mutex lock;
+    std::condition_variable cv;
+    bool finished = false;
+    Status status = Status::SUCC;
+    std::shared_ptr<Frame> data;
+  };
+  auto sync = std::make_shared<Sync>();
+  Status taken = process_async(idx, frames, latests, data,
+                               [sync](Status status, std::shared_ptr<Frame>& frame) {
+    std::lock_guard<std::mutex> guard(sync->lock);
+    sync->status = status;
+    sync->data = frame;
+    sync->finished = true;
+    sync->cv.notify_one();
+  });
+  if (taken != Status::SUCC) {
+    return taken;
+  }
+  std::unique_lock<std::mutex> guard(sync->lock);
+  while (!sync->finished) {
+    if (stop_) {
+      return Status::FAIL;
+    }
+    sync->cv.wait_for(guard, std::chrono::milliseconds(100));
+  }
+  data = sync->data;
+  return sync->status;
+}
+
+size_t ReplicaProcessor::select() {
+  size_t k = next_replica_;
+  next_replica_ = (next_replica_ + 1) % replicas_.size();
+  if (dispatch_ != OperatorConfig::LEAST_LOADED) {
+    return k;
+  }
+  // the fewest frames, from the next one in turn on a tie
+  int min_load = replicas_[k]->load.load(std::memory_order_relaxed);
+  for (size_t i = 1; i < replicas_.size() && min_load > 0; ++i) {
+    size_t j = (next_replica_ + i - 1) % replicas_.size();
+    int load = replicas_[j]->load.load(std::memory_order_relaxed);
+    if (load < min_load) {
+      min_load = load;
+      k = j;
+    }
+  }
+  return k;
+}
+
+Status ReplicaProcessor::process_async(const int& idx,
+                                       const std::vector<std::shared_ptr<const Frame>>& frames,
+                                       const std::vector<std::shared_ptr<const Frame>>& latests,
+                                       std::shared_ptr<Frame>& data, Done done) {
+  if (stop_) {
+    return Status::FAIL;
+  }
+  Job job;
+  job.idx = idx;
+  job.frames = frames;
+  job.latests = latests;
+  job.data = data;
+  job.done = std::move(done);
+
+  {
+    // the sequence is the order of the done callbacks, taken with the replica
+    std::lock_guard<std::mutex> lock(dispatch_lock_);
+    job.seq = next_seq_;
+    Replica* replica = replicas_[select()].get();
+    replica->load.fetch_add(1, std::memory_order_relaxed);
+    static const int64_t kWaitUs = 100000;
+    while (!replica->channel.push(job, kWaitUs)) {
+      if (stop_) {
+        replica->load.fetch_sub(1, std::memory_order_relaxed);
+        return Status::FAIL;
+      }
+    }
+    ++next_seq_;
+  }
+  // the lateness is checked on each frame, even if no replica finishes
+  std::unique_lock<std::mutex> lock(reorder_lock_);
+  flush(get_now_microsecond());
+  deliver(&lock);
+  return Status::SUCC;
+}
+
+void ReplicaProcessor::run_replica(size_t k) {
+  auto& replica = *replicas_[k];
+  Job job;
+  while (!stop_) {
+    // an idle replica checks the lateness, the frames held for an earlier one
+    // expire even when the triggers stop
+    if (max_lateness_ == 0) {
+      replica.channel.pop(&job);
+    } else if (!replica.channel.pop(&job, max_lateness_)) {
+      std::unique_lock<std::mutex> lock(reorder_lock_);
+      flush(get_now_microsecond());
+      deliver(&lock);
+      continue;
+    }
+    if (job.stop) {
+      break;
+    }
+    Status status;
+    if (!replica.peeked) {
+      replica.peeked = true;
+      status = replica.processor->peek(job.idx, job.frames, job.data);
+    } else {
+      status = replica.processor->process(job.idx, job.frames, job.latests, job.data);
+    }
+    replica.load.fetch_sub(1, std::memory_order_relaxed);
+    finish(job.seq, status, job.data, job.done);
+    job = Job();
+  }
+}
+
+void ReplicaProcessor::finish(uint64_t seq, Status status, std::shared_ptr<Frame>& data,
+                              Done& done) {
+  std::unique_lock<std::mutex> lock(reorder_lock_);
+  uint64_t now = get_now_microsecond();
+  if (seq < done_seq_) {
+    // dropped already, it is too late
+    ready_.emplace_back(Result{Status::FAIL, data, std::move(done), now});
+  } else {
+    reorder_.emplace(seq, Result{status, data, std::move(done), now});
+    flush(now);
+  }
+  deliver(&lock);
+}
+
+void ReplicaProcessor::flush(uint64_t now) {
+  while (!reorder_.empty()) {
+    auto iter = reorder_.begin();
+    if (iter->first != done_seq_) {
+      // the earlier frames are still running
+      if (max_lateness_ == 0 || now < iter->second.finish_time + max_lateness_) {
+        return;
+      }
+      uint64_t late = iter->first - done_seq_;
+      if (dropped_.fetch_add(late, std::memory_order_relaxed) == 0) {
+        LOG(ERROR) << "ReplicaProcessor: " << *this << " drops the late frames: " << late;
+      }
+      done_seq_ = iter->first;
+    }
+    ready_.emplace_back(std::move(iter->second));
+    reorder_.erase(iter);
+    ++done_seq_;
+  }
+}
+
+void ReplicaProcessor::deliver(std::unique_lock<std::mutex>* lock) {
+  if (delivering_) {
+    return;
+  }
+  delivering_ = true;
+  std::deque<Result> ready;
+  while (!ready_.empty()) {
+    ready.swap(ready_);
+    lock->unlock();
+    for (auto& result : ready) {
+      result.done(result.status, result.data);
+    }
+    ready.clear();
+    lock->lock();
+  }
+  delivering_ = false;
+}
+
 }  // namespace framework
 }  // namespace airi
 }  // namespace crdc
@@ -5,13 +5,21 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
+#include "common/bounded_channel.h"
 #include "framework/op.h"
 #include "framework/cached_data.h"
+#include "framework/latency_histogram.h"
+#include "framework/tracer.h"
 #include "framework/proto/dag_config.pb.h"
 
 namespace crdc {
@@ -21,12 +29,15 @@ namespace framework {
 
 class Processor {
  public:
+  using Done = std::function<void(Status status, std::shared_ptr<Frame>& data)>;
+
   Processor() = default;
+  virtual ~Processor() = default;
 
   /**
    * @brief stop all the op
    */
-  void stop() {
+  virtual void stop() {
     for (auto& op : ops_) {
       if (op) {
         op->stop();
@@ -68,6 +79,11 @@ class Processor {
     trigger_event_name_ = trigger_event_name;
   }
 
+  /**
+   * @brief set the priority of the tasks, for the processors running on the pool
+   */
+  void set_priority(int priority) { priority_ = priority; }
+
   /**
    * @brief set trigger data names
    */
@@ -105,6 +121,52 @@ class Processor {
                          const std::vector<std::shared_ptr<const Frame>>& latests,
                          std::shared_ptr<Frame>& data) = 0;
 
+  /**
+   * @brief whether the processor finishes the frames after process_async returns
+   */
+  virtual bool is_async() const { return false; }
+
+  /**
+   * @brief execute once without waiting for the ops. The done callback gets the
+   *        status and the frame when the ops finished, in the order of the calls.
+   * @return FAIL if the frame is not taken[Status]
+   */
+  virtual Status process_async(const int& idx,
+                               const std::vector<std::shared_ptr<const Frame>>& frames,
+                               const std::vector<std::shared_ptr<const Frame>>& latests,
+                               std::shared_ptr<Frame>& data, Done done) {
+    Status ret = process(idx, frames, latests, data);
+    done(ret, data);
+    return ret;
+  }
+
+  /**
+   * @brief the time of the j-th op for the idx-th trigger
+   * @return nullptr if not recorded
+   */
+  LatencyHistogram* op_latency(int idx, int j) const {
+    if (idx < 0 || static_cast<size_t>(idx) >= latency_.size() || j < 0 ||
+        static_cast<size_t>(j) >= latency_[idx].size()) {
+      return nullptr;
+    }
+    return latency_[idx][j].get();
+  }
+
+  /**
+   * @brief the percentiles of the time of each op for each trigger
+   */
+  std::string latency_summary() const;
+
+  /**
+   * @brief record the op times into the histograms of this processor, for the
+   *        replicas of the same ops
+   */
+  void share_latency(Processor* replica) const {
+    replica->latency_ = latency_;
+    replica->perf_string_ = perf_string_;
+    replica->trace_name_ = trace_name_;
+  }
+
  protected:
   /**
    * @brief init op
@@ -119,10 +181,35 @@ class Processor {
   bool io_sanity_check(const std::shared_ptr<Op>& in, const std::shared_ptr<Op>& out);
 
   /**
-   * @brief init the perfermence in string
+   * @brief init the perfermence in string, and the histograms of the op times
    */
   void init_perf_string(const OpGroupConfig& config);
 
+  /**
+   * @brief the start time for run_op, 0 without the histograms
+   */
+  uint64_t latency_start() const { return latency_.empty() ? 0 : LatencyHistogram::now(); }
+
+  /**
+   * @brief run the j-th op by the call, and record its time for the idx-th trigger.
+   *        The start is moved to the end, where the next op of a sequence starts.
+   *        The op is a span of the tracer with the timestamp of the frame.
+   */
+  template <typename Call>
+  Status run_op(int idx, int j, const std::shared_ptr<Frame>& data, uint64_t* start, Call call) {
+    TraceSpan span(trace_name_[j], Tracer::enabled() && data && data->base_frame ?
+                                   data->base_frame->utime : 0);
+    LatencyHistogram* latency = op_latency(idx, j);
+    if (!latency) {
+      return call();
+    }
+    Status ret = call();
+    uint64_t end = LatencyHistogram::now();
+    latency->record(end - *start);
+    *start = end;
+    return ret;
+  }
+
   std::vector<std::string> input_event_name_;
   std::vector<std::string> output_event_name_;
   std::vector<std::string> latest_event_name_;
@@ -130,9 +217,14 @@ class Processor {
   std::vector<std::string> trigger_data_name_;
 
   std::string name_;
+  int priority_ = 0;
   std::vector<OpConfig> configs_;
   std::vector<std::shared_ptr<Op>> ops_;
   std::vector<std::vector<std::string>> perf_string_;
+  // the span name of each op in the tracer
+  std::vector<int> trace_name_;
+  // the op times of each trigger, empty if disabled
+  std::vector<std::vector<std::shared_ptr<LatencyHistogram>>> latency_;
 };
 
 std::ostream& operator<<(std::ostream& os, const Processor& p);
@@ -155,6 +247,268 @@ class SeqProcessor : public Processor {
   std::vector<int> valid_;
 };
 
+/**
+ * @brief the Processor which executes the Ops by their dependencies. The ready Ops
+ *        run at the same time, on the calling thread and the WorkStealingPool, and
+ *        all of them are joined before it returns. The Ops running at the same time
+ *        share the trigger frame, so they must write different parts of it.
+ */
+class ParallelProcessor : public Processor {
+ public:
+  bool init(const OpGroupConfig& group) override;
+  Status peek(const int& idx, const std::vector<std::shared_ptr<const Frame>>& frames,
+              std::shared_ptr<Frame>& data) override;
+  Status process(const int& idx, const std::vector<std::shared_ptr<const Frame>>& frames,
+                 const std::vector<std::shared_ptr<const Frame>>& latests,
+                 std::shared_ptr<Frame>& data) override;
+
+ private:
+  // the state of one execution, shared with the helper tasks
+  struct Run {
+    std::function<Status(int)> call;
+    bool is_peek = false;
+    std::mutex lock;
+    std::condition_variable cv;
+    std::deque<int> ready;
+    std::vector<int> depends;
+    std::vector<Status> status;
+    // the helper tasks submitted and not started
+    size_t queued = 0;
+    size_t running = 0;
+    size_t finished = 0;
+    Status failed = Status::SUCC;
+  };
+
+  /**
+   * @brief resolve the `depend` of the ops, fails on an unknown op or a loop
+   */
+  bool init_depends();
+
+  /**
+   * @brief run all the valid ops by the call, returns after all of them finished
+   *        or one failed without ignore_fail
+   */
+  Status run(bool is_peek, std::function<Status(int)> call);
+
+  /**
+   * @brief take and run the ready ops. The helper returns when no op is ready,
+   *        the caller waits until the end.
+   */
+  void execute(const std::shared_ptr<Run>& run, bool is_helper);
+
+  bool ignore_fail_ = false;
+  OpGroupConfig config_;
+  std::vector<int> valid_;
+  // the ops waiting for each op, and the number of the ops each op waits for
+  std::vector<std::vector<int>> downstreams_;
+  std::vector<int> num_depends_;
+};
+
+/**
+ * @brief the Processor which executes each Op as a stage with its own thread. The
+ *        frames are handed over between the stages by the bounded channels, so the
+ *        consecutive frames run in different stages at the same time. The throughput
+ *        is bound by the slowest stage instead of the sum of the Ops.
+ */
+class PipelineProcessor : public Processor {
+ public:
+  PipelineProcessor() = default;
+  ~PipelineProcessor() override;
+
+  bool init(const OpGroupConfig& group) override;
+  void stop() override;
+  Status peek(const int& idx, const std::vector<std::shared_ptr<const Frame>>& frames,
+              std::shared_ptr<Frame>& data) override;
+  Status process(const int& idx, const std::vector<std::shared_ptr<const Frame>>& frames,
+                 const std::vector<std::shared_ptr<const Frame>>& latests,
+                 std::shared_ptr<Frame>& data) override;
+
+  bool is_async() const override { return true; }
+  Status process_async(const int& idx, const std::vector<std::shared_ptr<const Frame>>& frames,
+                       const std::vector<std::shared_ptr<const Frame>>& latests,
+                       std::shared_ptr<Frame>& data, Done done) override;
+
+ private:
+  // a frame going through the stages
+  struct Job {
+    int idx = 0;
+    std::vector<std::shared_ptr<const Frame>> frames;
+    std::vector<std::shared_ptr<const Frame>> latests;
+    std::shared_ptr<Frame> data;
+    Status status = Status::SUCC;
+    Done done;
+    bool stop = false;
+  };
+  using JobChannel = crdc::airi::common::BoundedChannel<Job>;
+
+  class Stage : public crdc::airi::common::Thread {
+   public:
+    Stage(PipelineProcessor* processor, size_t k, size_t queue_size)
+        : crdc::airi::common::Thread(true), channel(queue_size), processor_(processor),
+          k_(k) {}
+    ALIGNED_NEW(64);
+
+    JobChannel channel;
+
+   protected:
+    void run() override { processor_->run_stage(k_); }
+
+   private:
+    PipelineProcessor* processor_;
+    size_t k_;
+  };
+
+  /**
+   * @brief the loop of the k-th stage, runs its op and hands the frame to the next
+   *        stage. The last one calls the done callback.
+   */
+  void run_stage(size_t k);
+
+  /**
+   * @brief hand the job to the channel, waits for the room until stopped
+   */
+  bool hand_over(JobChannel* channel, const Job& job);
+
+  /**
+   * @brief drop the job not finished, its done callback is called with FAIL
+   */
+  void drop(Job* job);
+
+  bool ignore_fail_ = false;
+  OpGroupConfig config_;
+  std::vector<int> valid_;
+  std::vector<std::unique_ptr<Stage>> stages_;
+  std::atomic<bool> stop_{false};
+};
+
+/**
+ * @brief the Processor which runs the frames on the replicas of a processor, each on
+ *        its own thread, for the operator which could not keep up with its trigger.
+ *        The results go through a reorder buffer, so the done callbacks are still
+ *        called in the order of the calls. A frame later than the lateness bound is
+ *        dropped, and gets FAIL when it finishes.
+ */
+class ReplicaProcessor : public Processor {
+ public:
+  /**
+   * @param[in] the processor instances, not initialized
+   * @param[in] how the frames are dispatched to the replicas
+   * @param[in] the max time (us) a finished frame waits for an earlier one, 0 for ever
+   */
+  ReplicaProcessor(const std::vector<std::shared_ptr<Processor>>& replicas,
+                   OperatorConfig::ReplicaDispatch dispatch, uint64_t max_lateness);
+  ~ReplicaProcessor() override;
+
+  bool init(const OpGroupConfig& group) override;
+  void stop() override;
+  Status peek(const int& idx, const std::vector<std::shared_ptr<const Frame>>& frames,
+              std::shared_ptr<Frame>& data) override;
+  Status process(const int& idx, const std::vector<std::shared_ptr<const Frame>>& frames,
+                 const std::vector<std::shared_ptr<const Frame>>& latests,
+                 std::shared_ptr<Frame>& data) override;
+
+  bool is_async() const override { return true; }
+  Status process_async(const int& idx, const std::vector<std::shared_ptr<const Frame>>& frames,
+                       const std::vector<std::shared_ptr<const Frame>>& latests,
+                       std::shared_ptr<Frame>& data, Done done) override;
+
+  /**
+   * @brief the frames dropped by the lateness bound
+   */
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Job {
+    uint64_t seq = 0;
+    int idx = 0;
+    std::vector<std::shared_ptr<const Frame>> frames;
+    std::vector<std::shared_ptr<const Frame>> latests;
+    std::shared_ptr<Frame> data;
+    Done done;
+    bool stop = false;
+  };
+  using JobChannel = crdc::airi::common::BoundedChannel<Job>;
+
+  // a finished frame waiting for the earlier ones
+  struct Result {
+    Status status;
+    std::shared_ptr<Frame> data;
+    Done done;
+    uint64_t finish_time;
+  };
+
+  class Replica : public crdc::airi::common::Thread {
+   public:
+    Replica(ReplicaProcessor* owner, size_t k, const std::shared_ptr<Processor>& processor)
+        : crdc::airi::common::Thread(true), channel(kQueueSize), processor(processor),
+          owner_(owner), k_(k) {}
+    ALIGNED_NEW(64);
+
+    JobChannel channel;
+    std::shared_ptr<Processor> processor;
+    // the frames queued and running
+    std::atomic<int> load{0};
+    bool peeked = false;
+
+   protected:
+    void run() override { owner_->run_replica(k_); }
+
+   private:
+    ReplicaProcessor* owner_;
+    size_t k_;
+  };
+
+  static const size_t kQueueSize = 2;
+
+  /**
+   * @brief the loop of the k-th replica
+   */
+  void run_replica(size_t k);
+
+  /**
+   * @brief the replica which takes the next frame
+   */
+  size_t select();
+
+  /**
+   * @brief put the result in the reorder buffer, then call the done callbacks of
+   *        the frames in order
+   */
+  void finish(uint64_t seq, Status status, std::shared_ptr<Frame>& data, Done& done);
+
+  /**
+   * @brief move the results in order to the ready ones, drops the frames later than
+   *        the bound. Called with reorder_lock_ held.
+   */
+  void flush(uint64_t now);
+
+  /**
+   * @brief call the done callbacks of the ready results without the lock. Only one
+   *        thread calls them at a time, so they stay in order.
+   * @param [in] the lock of reorder_lock_, held on entry and on return
+   */
+  void deliver(std::unique_lock<std::mutex>* lock);
+
+  std::vector<std::unique_ptr<Replica>> replicas_;
+  OperatorConfig::ReplicaDispatch dispatch_;
+  uint64_t max_lateness_;
+  std::atomic<bool> stop_{false};
+
+  std::mutex dispatch_lock_;
+  uint64_t next_seq_ = 0;
+  size_t next_replica_ = 0;
+
+  std::mutex reorder_lock_;
+  std::map<uint64_t, Result> reorder_;
+  // the next frame to call the done callback
+  uint64_t done_seq_ = 0;
+  // the results whose done callbacks are due, in order
+  std::deque<Result> ready_;
+  // a thread is calling the done callbacks, the others only add the results
+  bool delivering_ = false;
+  std::atomic<uint64_t> dropped_{0};
+};
+
 }  // namespace framework
 }  // namespace airi
 }  // namespace crdc
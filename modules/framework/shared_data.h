@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
@@ -22,25 +23,28 @@ DECLARE_int32(shared_data_stale_time);
 
 /**
  * @brief This structure is used to store the status of the shared data
- *        It contains three counters.
+ *        It contains four counters.
  */
 struct SharedDataStatus {
   std::string to_string() const {
     std::ostringstream oss;
     oss << "counter_add:" << counter_add
         << " counter_remove:" << counter_remove
-        << " counter_get:" << counter_get;
+        << " counter_get:" << counter_get
+        << " counter_evict:" << counter_evict;
     return oss.str();
   }
 
   uint64_t counter_add = 0;
   uint64_t counter_remove = 0;
   uint64_t counter_get = 0;
+  // removed by the byte budget
+  uint64_t counter_evict = 0;
 };
 
 class SharedData {
  public:
-  SharedData() : key_("SharedData") {
+  SharedData() : key_("SharedData"), byte_budget_(0) {
     event_manager_ = crdc::airi::common::Singleton<EventManager>::get();
   }
   virtual ~SharedData() = default;
@@ -56,8 +60,30 @@ class SharedData {
    */
   virtual void remove_stale_data() { CHECK(false) << "remove_stale_data() not implemented."; }
   virtual std::string name() const = 0;
+
+  /**
+   * @brief the bytes held by the shared data
+   */
   virtual size_t size() const = 0;
-  const SharedDataStatus stat() const { return stat_; }
+
+  /**
+   * @brief the number of the data held
+   */
+  virtual size_t count() const { return 0; }
+  virtual const SharedDataStatus stat() const { return stat_; }
+
+  /**
+   * @brief the max bytes could be held, the oldest data is evicted when exceeded.
+   *        0 for unlimited.
+   */
+  virtual void set_byte_budget(size_t bytes) { byte_budget_ = bytes; }
+  size_t byte_budget() const { return byte_budget_; }
+
+  /**
+   * @brief evict the oldest data, used by SharedDataManager for the global budget.
+   * @return the bytes of the evicted data, 0 if nothing could be evicted
+   */
+  virtual size_t evict_oldest() { return 0; }
 
   virtual void set_key(const std::string& key) {
     key_ = key;
@@ -68,6 +94,7 @@ class SharedData {
   std::string key_;
   mutable SharedDataStatus stat_;
   EventManager* event_manager_;
+  std::atomic<size_t> byte_budget_;
 
  private:
   DISALLOW_COPY_AND_ASSIGN(SharedData);
@@ -6,6 +6,10 @@
 //              in the cache data herite from shared data.
 
 #include "framework/shared_data_manager.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <utility>
 
 namespace crdc {
 namespace airi {
@@ -29,22 +33,25 @@ bool SharedDataManager::register_cached_data(const std::string& name, const std:
     return false;
   }
   shared_data->set_key(name);
+  shared_data->set_byte_budget(static_cast<size_t>(FLAGS_cached_data_byte_budget_mb) << 20);
   shared_data_map_[name] = shared_data;
   key_type_map_[name] = type;
   return true;
 }
 
-bool SharedDataManager::register_frame_cached_data(const std::string& name, size_t freq) {
+bool SharedDataManager::register_frame_cached_data(const std::string& name, size_t freq,
+                                                   OperatorOutput::CacheBackend backend) {
   if (shared_data_map_.find(name) != shared_data_map_.end()) {
     LOG(ERROR) << "Cached Data:" << name << " already registered!";
     return false;
   }
-  std::shared_ptr<SharedData> shared_data(new FrameCachedData(freq));
+  std::shared_ptr<SharedData> shared_data(new FrameCachedData(freq, backend));
   if (!shared_data) {
     LOG(ERROR) << "Cached Data:[" << name << "] get error";
     return false;
   }
   shared_data->set_key(name);
+  shared_data->set_byte_budget(static_cast<size_t>(FLAGS_cached_data_byte_budget_mb) << 20);
   shared_data_map_[name] = shared_data;
   key_type_map_[name] = "FrameCachedData";
   return true;
@@ -91,6 +98,78 @@ void SharedDataManager::remove_stale_data() {
   LOG(INFO) << "remove stale SharedData. nums: " << shared_data_map_.size();
 }
 
+bool SharedDataManager::set_byte_budget(const std::string& name, size_t bytes) {
+  auto citer = shared_data_map_.find(name);
+  if (citer == shared_data_map_.end()) {
+    LOG(ERROR) << "SharedData: <" << name << "> NOT REGISTERED!";
+    return false;
+  }
+  citer->second->set_byte_budget(bytes);
+  return true;
+}
+
+size_t SharedDataManager::total_bytes() const {
+  size_t bytes = 0;
+  for (auto& shared_data : shared_data_map_) {
+    bytes += shared_data.second->size();
+  }
+  return bytes;
+}
+
+void SharedDataManager::enforce_byte_budget() {
+  const size_t budget = static_cast<size_t>(FLAGS_shared_data_byte_budget_mb) << 20;
+  if (budget == 0) {
+    return;
+  }
+  size_t total = total_bytes();
+  if (total <= budget) {
+    return;
+  }
+
+  const size_t before = total;
+  std::vector<std::pair<size_t, SharedData*>> candidates;
+  for (auto& shared_data : shared_data_map_) {
+    candidates.emplace_back(shared_data.second->size(), shared_data.second.get());
+  }
+  while (total > budget && !candidates.empty()) {
+    auto largest = std::max_element(candidates.begin(), candidates.end());
+    if (largest->second->evict_oldest() == 0) {
+      // nothing more could be evicted from it
+      candidates.erase(largest);
+      continue;
+    }
+    // the charge of a frame still held by another cache moves to it, measure again
+    for (auto& candidate : candidates) {
+      candidate.first = candidate.second->size();
+    }
+    total = total_bytes();
+  }
+  LOG(WARNING) << "SharedData over budget " << budget << " bytes, evicted "
+               << before - total << " bytes, now " << total << " bytes.";
+}
+
+std::string SharedDataManager::memory_report() const {
+  std::vector<std::pair<size_t, std::string>> caches;
+  size_t total = 0;
+  for (auto& shared_data : shared_data_map_) {
+    caches.emplace_back(shared_data.second->size(), shared_data.first);
+    total += shared_data.second->size();
+  }
+  std::sort(caches.rbegin(), caches.rend());
+
+  std::ostringstream oss;
+  oss << "SharedData memory: " << total << " bytes, budget: "
+      << (static_cast<size_t>(FLAGS_shared_data_byte_budget_mb) << 20) << " bytes" << std::endl;
+  for (auto& p : caches) {
+    const auto& shared_data = shared_data_map_.at(p.second);
+    oss << std::setw(12) << p.first << " bytes " << std::setw(6) << shared_data->count()
+        << " items budget: " << shared_data->byte_budget() << " evicted: "
+        << shared_data->stat().counter_evict << " " << p.second << " ("
+        << shared_data->name() << ")" << std::endl;
+  }
+  return oss.str();
+}
+
 }  // namespace airi
 }  // namespace crdc
 
@@ -19,6 +19,9 @@
 namespace crdc {
 namespace airi {
 
+DECLARE_int32(shared_data_byte_budget_mb);
+DECLARE_int32(cached_data_byte_budget_mb);
+
 class SharedDataManager {
  public:
   SharedDataManager() = default;
@@ -37,17 +40,43 @@ class SharedDataManager {
       return false;
     }
     shared_data->set_key(name);
+    shared_data->set_byte_budget(static_cast<size_t>(FLAGS_cached_data_byte_budget_mb) << 20);
     shared_data_map_[name] = shared_data;
     key_type_map_[name] = "CachedData";
     return true;
   }
-  bool register_frame_cached_data(const std::string& name, size_t freq);
+  bool register_frame_cached_data(const std::string& name, size_t freq,
+                                  OperatorOutput::CacheBackend backend = OperatorOutput::MAP);
   bool register_data_event(const std::string& name, const std::string& event);
   SharedData* get_shared_data(const std::string& name) const;
   SharedData* get_event_data(const std::string& name) const;
   void reset();
   void remove_stale_data();
 
+  /**
+   * @brief set the byte budget of a registered shared data
+   * @param [in] the name of the shared data
+   * @param [in] the max bytes, 0 for unlimited
+   * @return is the action success[bool]
+   */
+  bool set_byte_budget(const std::string& name, size_t bytes);
+
+  /**
+   * @brief the bytes held by all the shared data
+   */
+  size_t total_bytes() const;
+
+  /**
+   * @brief evict the oldest data of the largest shared data until all the shared
+   *        data fit in shared_data_byte_budget_mb.
+   */
+  void enforce_byte_budget();
+
+  /**
+   * @brief the memory held by each shared data, the largest first
+   */
+  std::string memory_report() const;
+
   friend std::ostream& operator<<(std::ostream& os, const SharedDataManager& mgr);
 
  private:
@@ -0,0 +1,69 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: get benchmark. The cost of the nearest timestamp get with tolerance
+//              across the cache sizes, from 10 Hz to 5 kHz.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "framework/cached_data.h"
+
+namespace crdc {
+namespace airi {
+
+static const int kQueries = 200000;
+static const uint64_t kStartTime = 1600000000000000ULL;
+
+/**
+ * @brief fill the cache with the data of the stale time, then get random keys up
+ *        to half a period and 0.5 ms after a data, which all the caches find with
+ *        tolerate 1
+ * @return the ns per get
+ */
+template <class Cache>
+double run(Cache* cache, int hz, int count) {
+  const uint64_t period = 1000000 / hz;
+  for (int i = 0; i < count; ++i) {
+    cache->put(kStartTime + i * period, std::make_shared<int>(i));
+  }
+  const uint64_t jitter = std::min<uint64_t>(500, period / 2);
+  std::mt19937_64 rng(1);
+  std::vector<uint64_t> keys(kQueries);
+  for (auto& key : keys) {
+    key = kStartTime + rng() % count * period + rng() % jitter;
+  }
+  int found = 0;
+  auto begin = std::chrono::steady_clock::now();
+  for (auto key : keys) {
+    std::shared_ptr<int> data;
+    found += cache->get(key, &data, 1);
+  }
+  auto end = std::chrono::steady_clock::now();
+  if (found != kQueries) {
+    printf("only %d of %d found\n", found, kQueries);
+  }
+  return std::chrono::duration<double, std::nano>(end - begin).count() / kQueries;
+}
+
+}  // namespace airi
+}  // namespace crdc
+
+int main(int argc, char** argv) {
+  for (int hz : {10, 100, 200, 1000, 5000}) {
+    const int count = hz * crdc::airi::FLAGS_cached_data_stale_time;
+    crdc::airi::StaticCachedData<int> static_cache(hz);
+    crdc::airi::DynamicCachedData<int> dynamic_cache;
+    crdc::airi::RingCachedData<int> ring_cache(hz);
+    double static_ns = crdc::airi::run(&static_cache, hz, count);
+    double dynamic_ns = crdc::airi::run(&dynamic_cache, hz, count);
+    double ring_ns = crdc::airi::run(&ring_cache, hz, count);
+    printf("%5d Hz %6d entries: static %6.1f ns, dynamic %6.1f ns, ring %6.1f ns per get\n",
+           hz, count, static_ns, dynamic_ns, ring_ns);
+  }
+  return 0;
+}
@@ -0,0 +1,68 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: get_newest benchmark. The reads per second of 1 to 16 reader threads
+//              calling get_newest while a producer puts at 1 kHz.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "framework/cached_data.h"
+
+namespace crdc {
+namespace airi {
+
+static const int kRunMs = 500;
+
+template <class Cache>
+void run(const std::string& name, Cache* cache) {
+  for (int readers : {1, 2, 4, 8, 16}) {
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> reads{0};
+    std::thread producer([&] {
+      uint64_t key = get_now_microsecond();
+      while (!stop) {
+        cache->put(++key, std::make_shared<Frame>());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+    std::vector<std::thread> threads;
+    for (int i = 0; i < readers; ++i) {
+      threads.emplace_back([&] {
+        uint64_t count = 0;
+        std::shared_ptr<const Frame> frame;
+        while (!stop) {
+          cache->get_newest(&frame);
+          ++count;
+        }
+        reads += count;
+      });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(kRunMs));
+    stop = true;
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    producer.join();
+    printf("%-8s readers %2d: %8.2f M get_newest/s\n", name.c_str(), readers,
+           reads / (kRunMs * 1e3));
+  }
+}
+
+}  // namespace airi
+}  // namespace crdc
+
+int main(int argc, char** argv) {
+  using crdc::airi::Frame;
+  crdc::airi::StaticCachedData<Frame> static_cache(1000);
+  crdc::airi::run("static", &static_cache);
+  crdc::airi::DynamicCachedData<Frame> dynamic_cache;
+  crdc::airi::run("dynamic", &dynamic_cache);
+  crdc::airi::RingCachedData<Frame> ring_cache(1000);
+  crdc::airi::run("ring", &ring_cache);
+  return 0;
+}
@@ -0,0 +1,223 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: cached ring test
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "framework/cached_ring.h"
+
+namespace crdc {
+namespace airi {
+
+using Ring = CachedRing<uint64_t>;
+
+// the data of each key is the key itself, so a torn read shows up as a mismatch
+static std::shared_ptr<uint64_t> make(uint64_t key) { return std::make_shared<uint64_t>(key); }
+
+TEST(CachedRingTest, CapacityIsRoundedUp) {
+  EXPECT_EQ(2u, Ring(1).capacity());
+  EXPECT_EQ(4u, Ring(3).capacity());
+  EXPECT_EQ(8u, Ring(8).capacity());
+}
+
+TEST(CachedRingTest, PushEvictsTheOldest) {
+  Ring ring(4);
+  uint64_t key = 0;
+  std::shared_ptr<uint64_t> data;
+  EXPECT_FALSE(ring.newest(&key, &data));
+  for (uint64_t k = 1; k <= 4; ++k) {
+    EXPECT_EQ(0u, ring.push(k * 10, make(k * 10), k));
+  }
+  // the bytes of the evicted one are given back
+  EXPECT_EQ(1u, ring.push(50, make(50), 5));
+  EXPECT_EQ(4u, ring.count());
+  EXPECT_EQ(50u, ring.newest_key());
+  EXPECT_TRUE(ring.newest(&key, &data));
+  EXPECT_EQ(50u, key);
+  EXPECT_EQ(50u, *data);
+  EXPECT_FALSE(ring.find(10, 0, &data));
+  EXPECT_TRUE(ring.find(20, 0, &data));
+  EXPECT_EQ(20u, *data);
+}
+
+TEST(CachedRingTest, FindTheNearest) {
+  Ring ring(8);
+  for (uint64_t k = 1; k <= 5; ++k) {
+    ring.push(k * 10, make(k * 10));
+  }
+  std::shared_ptr<uint64_t> data;
+  EXPECT_FALSE(ring.find(34, 0, &data));
+  EXPECT_TRUE(ring.find(34, 5, &data));
+  EXPECT_EQ(30u, *data);
+  EXPECT_TRUE(ring.find(37, 5, &data));
+  EXPECT_EQ(40u, *data);
+  // the earlier one wins on a tie
+  EXPECT_TRUE(ring.find(35, 6, &data));
+  EXPECT_EQ(30u, *data);
+  // the distance is exclusive
+  EXPECT_FALSE(ring.find(35, 5, &data));
+  EXPECT_TRUE(ring.find(1, 10, &data));
+  EXPECT_EQ(10u, *data);
+  EXPECT_TRUE(ring.find(59, 10, &data));
+  EXPECT_EQ(50u, *data);
+  EXPECT_FALSE(ring.find(100, 10, &data));
+}
+
+TEST(CachedRingTest, ForEachInRange) {
+  Ring ring(8);
+  for (uint64_t k = 1; k <= 6; ++k) {
+    ring.push(k * 10, make(k * 10));
+  }
+  std::vector<uint64_t> keys;
+  ring.for_each(20, 50, [&keys](uint64_t key, const std::shared_ptr<uint64_t>& data) {
+    EXPECT_EQ(key, *data);
+    keys.push_back(key);
+  });
+  EXPECT_EQ((std::vector<uint64_t>{30, 40, 50}), keys);
+}
+
+TEST(CachedRingTest, PopClearAndKeepNewest) {
+  Ring ring(4);
+  ring.push(10, make(10), 1);
+  ring.push(20, make(20), 2);
+  EXPECT_EQ(1u, ring.pop());
+  EXPECT_EQ(1u, ring.count());
+  std::shared_ptr<uint64_t> data;
+  EXPECT_FALSE(ring.find(10, 0, &data));
+  ring.keep_newest(30, make(30));
+  ring.keep_newest(40, make(40));
+  EXPECT_EQ(1u, ring.count());
+  uint64_t key = 0;
+  EXPECT_TRUE(ring.newest(&key, &data));
+  EXPECT_EQ(40u, *data);
+  ring.clear();
+  EXPECT_EQ(0u, ring.count());
+  EXPECT_FALSE(ring.newest(&key, &data));
+  EXPECT_EQ(0u, ring.pop());
+}
+
+TEST(CachedRingTest, Replace) {
+  Ring ring(4);
+  ring.push(10, make(10), 1);
+  ring.push(20, make(20), 2);
+  size_t old_bytes = 0;
+  EXPECT_FALSE(ring.replace(15, make(15), 3, &old_bytes));
+  EXPECT_TRUE(ring.replace(20, make(20), 3, &old_bytes));
+  EXPECT_EQ(2u, old_bytes);
+  // the new bytes go back when it is dropped
+  ring.pop();
+  EXPECT_EQ(3u, ring.pop());
+}
+
+TEST(CachedRingTest, PushNewerRejectsOldKeys) {
+  Ring ring(2);
+  size_t evicted = 0;
+  EXPECT_TRUE(ring.push_newer(20, make(20), 1, &evicted));
+  EXPECT_FALSE(ring.push_newer(20, make(20), 1, &evicted));
+  EXPECT_FALSE(ring.push_newer(10, make(10), 1, &evicted));
+  EXPECT_TRUE(ring.push_newer(30, make(30), 2, &evicted));
+  EXPECT_EQ(0u, evicted);
+  std::shared_ptr<uint64_t> data;
+  EXPECT_TRUE(ring.push_newer(40, make(40), 3, &evicted, &data));
+  EXPECT_EQ(1u, evicted);
+  EXPECT_EQ(20u, *data);
+  // an empty ring takes any key
+  ring.clear();
+  EXPECT_TRUE(ring.push_newer(5, make(5), 1, &evicted));
+}
+
+TEST(CachedRingTest, PushNewerFromSeveralProducers) {
+  static const uint64_t kCount = 100000;
+  Ring ring(64);
+  std::atomic<uint64_t> next{0};
+  std::vector<std::thread> producers;
+  for (int p = 0; p < 4; ++p) {
+    producers.emplace_back([&ring, &next] {
+      size_t evicted = 0;
+      uint64_t key = 0;
+      while ((key = next.fetch_add(1) + 1) <= kCount) {
+        ring.push_newer(key, make(key), 1, &evicted);
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  uint64_t last = 0;
+  ring.for_each(0, UINT64_MAX - 1, [&last](uint64_t key, const std::shared_ptr<uint64_t>& data) {
+    EXPECT_EQ(key, *data);
+    EXPECT_LT(last, key);
+    last = key;
+  });
+  EXPECT_EQ(kCount, ring.newest_key());
+}
+
+// a producer pushes, another thread replaces, the readers check what they copy
+static void stress(bool keep_newest) {
+  static const uint64_t kCount = 200000;
+  Ring ring(8);
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> errors{0};
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; ++r) {
+    readers.emplace_back([&ring, &stop, &errors, r] {
+      uint64_t key = 0;
+      std::shared_ptr<uint64_t> data;
+      while (!stop.load(std::memory_order_relaxed)) {
+        if (ring.newest(&key, &data) && (!data || *data != key)) {
+          errors.fetch_add(1);
+        }
+        uint64_t newest = ring.newest_key();
+        if (newest > 0 && ring.find(newest - r, 2, &data) &&
+            (!data || *data + 2 <= newest - r)) {
+          errors.fetch_add(1);
+        }
+        uint64_t last = 0;
+        ring.for_each(0, UINT64_MAX - 1,
+                      [&errors, &last](uint64_t k, const std::shared_ptr<uint64_t>& d) {
+          if (!d || *d != k || k <= last) {
+            errors.fetch_add(1);
+          }
+          last = k;
+        });
+      }
+    });
+  }
+  std::thread replacer([&ring, &stop] {
+    size_t old_bytes = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+      uint64_t newest = ring.newest_key();
+      ring.replace(newest, make(newest), 0, &old_bytes);
+      std::this_thread::yield();
+    }
+  });
+  for (uint64_t k = 1; k <= kCount; ++k) {
+    if (keep_newest) {
+      ring.keep_newest(k, make(k));
+    } else {
+      ring.push(k, make(k));
+    }
+  }
+  stop = true;
+  replacer.join();
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(0u, errors.load());
+  uint64_t key = 0;
+  std::shared_ptr<uint64_t> data;
+  EXPECT_TRUE(ring.newest(&key, &data));
+  EXPECT_EQ(kCount, *data);
+}
+
+TEST(CachedRingTest, ConcurrentPushAndReaders) { stress(false); }
+
+TEST(CachedRingTest, ConcurrentKeepNewestAndReaders) { stress(true); }
+
+}  // namespace airi
+}  // namespace crdc
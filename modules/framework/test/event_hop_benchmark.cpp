@@ -0,0 +1,91 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: event hop benchmark. The latency of an event from the publisher to the
+//              blocked subscriber, by a ping-pong of two threads on two edges of the
+//              EventManager, and on the mutex queues the edges used before.
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "common/concurrent_queue.h"
+#include "framework/event_manager.h"
+
+namespace crdc {
+namespace airi {
+
+static const int kRounds = 100000;
+
+/**
+ * @brief ping on the first queue, pong on the second
+ * @return the us of one hop, half a round trip
+ */
+template <class Ping, class Pong>
+double ping_pong(Ping ping, Pong pong) {
+  std::thread peer([&] {
+    Event event;
+    for (int i = 0; i < kRounds; ++i) {
+      pong(&event);
+    }
+  });
+  Event event;
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < kRounds; ++i) {
+    event.timestamp = i;
+    ping(&event);
+  }
+  auto end = std::chrono::steady_clock::now();
+  peer.join();
+  return std::chrono::duration<double, std::micro>(end - begin).count() / kRounds / 2;
+}
+
+double event_manager_hop() {
+  std::vector<EventMeta> events(2);
+  events[0].event_id = 1;
+  events[0].from_node = 0;
+  events[0].to_node = 1;
+  events[0].name = "ping";
+  events[1].event_id = 2;
+  events[1].from_node = 1;
+  events[1].to_node = 0;
+  events[1].name = "pong";
+  EventManager event_manager;
+  event_manager.init(events, DAGConfig());
+  EventManager::EventQueue* ping = event_manager.get_event_queue(1);
+  EventManager::EventQueue* pong = event_manager.get_event_queue(2);
+  return ping_pong(
+      [&](Event* event) {
+        event_manager.publish(ping, *event);
+        event_manager.subscribe(pong, event);
+      },
+      [&](Event* event) {
+        event_manager.subscribe(ping, event);
+        event_manager.publish(pong, *event);
+      });
+}
+
+double mutex_queue_hop() {
+  common::FixedSizeConQueue<Event> ping(1);
+  common::FixedSizeConQueue<Event> pong(1);
+  return ping_pong(
+      [&](Event* event) {
+        ping.push(*event);
+        pong.pop(event);
+      },
+      [&](Event* event) {
+        ping.pop(event);
+        pong.push(*event);
+      });
+}
+
+}  // namespace airi
+}  // namespace crdc
+
+int main(int argc, char** argv) {
+  for (int i = 0; i < 2; ++i) {
+    printf("hop: EventManager edge %6.2f us, FixedSizeConQueue %6.2f us\n",
+           crdc::airi::event_manager_hop(), crdc::airi::mutex_queue_hop());
+  }
+  return 0;
+}
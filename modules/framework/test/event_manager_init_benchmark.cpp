@@ -0,0 +1,60 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: EventManager::init benchmark. The startup of synthetic DAGs of 10 to
+//              5000 operators in layers of 4, each operator publishes to 2 of the next
+//              layer, so the number of the pipelines grows exponentially.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "framework/event_manager.h"
+
+namespace crdc {
+namespace airi {
+
+static const int kLayerWidth = 4;
+
+std::vector<EventMeta> make_dag(int operators) {
+  std::vector<EventMeta> events;
+  for (int op = 0; op + kLayerWidth < operators; ++op) {
+    const int layer = op / kLayerWidth;
+    const int column = op % kLayerWidth;
+    for (int fan = 0; fan < 2; ++fan) {
+      const int to = (layer + 1) * kLayerWidth + (column + fan) % kLayerWidth;
+      if (to >= operators) {
+        continue;
+      }
+      EventMeta event;
+      event.event_id = events.size() + 1;
+      event.from_node = op;
+      event.to_node = to;
+      event.name = "event_" + std::to_string(event.event_id);
+      events.emplace_back(event);
+    }
+  }
+  return events;
+}
+
+}  // namespace airi
+}  // namespace crdc
+
+int main(int argc, char** argv) {
+  for (int operators : {10, 50, 100, 300, 1000, 5000}) {
+    std::vector<crdc::airi::EventMeta> events = crdc::airi::make_dag(operators);
+    crdc::airi::EventManager event_manager;
+    auto begin = std::chrono::steady_clock::now();
+    event_manager.init(events, crdc::airi::DAGConfig());
+    auto end = std::chrono::steady_clock::now();
+    // the count of the pipelines saturates at UINT64_MAX
+    const uint64_t pipelines = event_manager.num_pipelines();
+    printf("%5d operators %5zu events: init %9.2f ms, %s pipelines, critical path %zu\n",
+           operators, events.size(),
+           std::chrono::duration<double, std::milli>(end - begin).count(),
+           pipelines == UINT64_MAX ? ">= 2^64" : std::to_string(pipelines).c_str(),
+           event_manager.critical_path().size());
+  }
+  return 0;
+}
@@ -0,0 +1,65 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: frame fan-out benchmark. The cost to put a published frame in the
+//              reference cache and the caches of 1 to 8 downstreams, with a copy for
+//              each cache or with the one copy on write frame Port::publish shares.
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "framework/cached_data.h"
+
+namespace crdc {
+namespace airi {
+
+static const int kFrames = 20000;
+static const uint64_t kStartTime = 1600000000000000ULL;
+
+/**
+ * @return the us per published frame
+ */
+double run(const Frame& trigger, int downstreams, bool shared) {
+  std::vector<std::unique_ptr<FrameCachedData>> caches;
+  for (int i = 0; i < downstreams + 1; ++i) {
+    caches.emplace_back(new FrameCachedData(30));
+  }
+  auto begin = std::chrono::steady_clock::now();
+  for (int k = 1; k <= kFrames; ++k) {
+    uint64_t key = kStartTime + k * 33333;
+    if (shared) {
+      std::shared_ptr<Frame> frame(new Frame(trigger));
+      frame->mark_shared(downstreams, true);
+      for (auto& cache : caches) {
+        cache->put(key, frame);
+      }
+    } else {
+      for (auto& cache : caches) {
+        cache->put(key, std::shared_ptr<Frame>(new Frame(trigger)));
+      }
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - begin).count() / kFrames;
+}
+
+}  // namespace airi
+}  // namespace crdc
+
+int main(int argc, char** argv) {
+  crdc::airi::Frame trigger;
+  trigger.frame_type = "lidar_frame_type_name";
+  for (int i = 0; i < 8; ++i) {
+    trigger.add_footprint("event_name_" + std::to_string(i));
+    trigger.supplement["key_" + std::to_string(i)] = std::string(64, 'x');
+  }
+  for (int downstreams : {1, 2, 4, 8}) {
+    double copy_us = crdc::airi::run(trigger, downstreams, false);
+    double shared_us = crdc::airi::run(trigger, downstreams, true);
+    printf("%d downstreams + reference: copy each %6.2f us, shared %6.2f us per frame\n",
+           downstreams, copy_us, shared_us);
+  }
+  return 0;
+}
@@ -0,0 +1,145 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: tracer
+
+#include "framework/tracer.h"
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iomanip>
+
+namespace crdc {
+namespace airi {
+
+std::atomic<bool> Tracer::enabled_{false};
+
+static std::string escape(const std::string& str) {
+  std::string escaped;
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    escaped += (static_cast<unsigned char>(c) < 0x20 ? ' ' : c);
+  }
+  return escaped;
+}
+
+bool Tracer::init(const std::string& file, size_t buffer_size) {
+  if (file.empty() || buffer_size == 0) {
+    LOG(ERROR) << "Tracer: invalid file: '" << file << "' or buffer size: " << buffer_size;
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(lock_);
+  file_ = file;
+  buffer_size_ = buffer_size;
+  origin_ = now();
+  enabled_.store(true, std::memory_order_release);
+  LOG(INFO) << "Tracer: trace into " << file_ << " with " << buffer_size_
+            << " spans per thread";
+  return true;
+}
+
+int Tracer::intern(const std::string& name) {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto iter = ids_.find(name);
+  if (iter != ids_.end()) {
+    return iter->second;
+  }
+  int id = names_.size();
+  names_.emplace_back(name);
+  ids_.emplace(name, id);
+  return id;
+}
+
+Tracer::ThreadBuffer* Tracer::buffer() {
+  // the buffers live as long as the tracer, after their threads exit
+  static thread_local ThreadBuffer* buffer = nullptr;
+  if (buffer) {
+    return buffer;
+  }
+  std::unique_ptr<ThreadBuffer> created(new ThreadBuffer);
+  created->tid = syscall(SYS_gettid);
+  char name[16] = {0};
+  if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0) {
+    created->name = name;
+  }
+  std::lock_guard<std::mutex> lock(lock_);
+  created->records.resize(buffer_size_);
+  buffer = created.get();
+  buffers_.emplace_back(std::move(created));
+  return buffer;
+}
+
+void Tracer::append(const Record& record) {
+  ThreadBuffer* buf = buffer();
+  uint64_t head = buf->head.load(std::memory_order_relaxed);
+  buf->records[head % buf->records.size()] = record;
+  buf->head.store(head + 1, std::memory_order_release);
+}
+
+void Tracer::span(int name, uint64_t begin, uint64_t end, uint64_t utime) {
+  append(Record{begin, end, utime, name, 'X'});
+}
+
+void Tracer::flow(int name, uint64_t id, bool start) {
+  if (!enabled()) {
+    return;
+  }
+  uint64_t time = now();
+  append(Record{time, time, id, name, start ? 's' : 'f'});
+}
+
+bool Tracer::flush() {
+  if (!enabled_.exchange(false)) {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(lock_);
+  std::ofstream out(file_);
+  if (!out) {
+    LOG(ERROR) << "Tracer: failed to open " << file_;
+    return false;
+  }
+  const int pid = getpid();
+  auto us = [this](uint64_t ns) { return (ns > origin_ ? ns - origin_ : 0) / 1000.0; };
+  uint64_t records = 0;
+  uint64_t overwritten = 0;
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl
+      << "{\"ph\":\"M\",\"pid\":" << pid
+      << ",\"name\":\"process_name\",\"args\":{\"name\":\"airi\"}}";
+  for (const auto& buf : buffers_) {
+    const std::string prefix = ",\n{\"pid\":" + std::to_string(pid) +
+                               ",\"tid\":" + std::to_string(buf->tid);
+    out << prefix << ",\"ph\":\"M\",\"name\":\"thread_name\",\"args\":{\"name\":\""
+        << escape(buf->name) << "\"}}";
+    const uint64_t head = buf->head.load(std::memory_order_acquire);
+    const uint64_t size = buf->records.size();
+    const uint64_t first = head > size ? head - size : 0;
+    overwritten += first;
+    for (uint64_t i = first; i < head; ++i) {
+      const Record& record = buf->records[i % size];
+      out << prefix << ",\"ph\":\"" << record.phase << "\",\"name\":\""
+          << escape(names_.at(record.name)) << "\",\"ts\":" << us(record.begin);
+      if (record.phase == 'X') {
+        out << ",\"cat\":\"airi\",\"dur\":" << (record.end - record.begin) / 1000.0
+            << ",\"args\":{\"utime\":" << record.arg << "}}";
+      } else {
+        // the flows bind to the enclosing spans of the publish and the consumer
+        out << ",\"cat\":\"event\",\"id\":\"0x" << std::hex << record.arg << std::dec
+            << "\"" << (record.phase == 'f' ? ",\"bp\":\"e\"" : "") << "}";
+      }
+      ++records;
+    }
+  }
+  out << "\n]}" << std::endl;
+  LOG(INFO) << "Tracer: " << records << " records of " << buffers_.size()
+            << " threads written into " << file_ << ", " << overwritten << " overwritten";
+  return out.good();
+}
+
+}  // namespace airi
+}  // namespace crdc
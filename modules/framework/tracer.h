@@ -0,0 +1,144 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: tracer. Records the spans of the workers, the ops and the ports into a
+//              ring buffer of each thread, lock free, and writes them into a Chrome
+//              trace-event JSON file (chrome://tracing or ui.perfetto.dev) on exit.
+
+#pragma once
+
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common/common.h"
+
+namespace crdc {
+namespace airi {
+
+DECLARE_string(trace_file);
+DECLARE_int32(trace_buffer_size);
+
+class Tracer {
+ public:
+  Tracer() = default;
+
+  /**
+   * @brief enable the tracer, called by DAGStreaming before the operators start
+   * @param [in] the JSON file to write
+   * @param [in] the spans kept in each thread, the oldest are overwritten
+   */
+  bool init(const std::string& file, size_t buffer_size);
+
+  /**
+   * @brief a relaxed load, the only cost of the spans when disabled
+   */
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief the time of the spans, in ns of the steady clock
+   */
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /**
+   * @brief the id of a span or flow name, interned once at init time
+   */
+  int intern(const std::string& name);
+
+  /**
+   * @brief record a span of the current thread
+   * @param [in] the name id
+   * @param [in] the begin and end time, ns
+   * @param [in] the timestamp of the frame, 0 if none
+   */
+  void span(int name, uint64_t begin, uint64_t end, uint64_t utime);
+
+  /**
+   * @brief record the start or the end of a flow arrow, bound to the enclosing span
+   * @param [in] the name id
+   * @param [in] the flow id, the same on both ends
+   * @param [in] true at the start, false at the end
+   */
+  void flow(int name, uint64_t id, bool start);
+
+  /**
+   * @brief the id of the flow of an event, from its publish to its consumer
+   */
+  static uint64_t flow_id(int event_id, uint64_t timestamp) {
+    return (static_cast<uint64_t>(event_id) << 52) ^ timestamp;
+  }
+
+  /**
+   * @brief write the spans into the file and disable the tracer.
+   *        Called after the workers are joined.
+   */
+  bool flush();
+
+ private:
+  struct Record {
+    uint64_t begin;
+    uint64_t end;
+    // the frame timestamp of a span, the id of a flow
+    uint64_t arg;
+    int name;
+    // 'X' span, 's' flow start, 'f' flow end
+    char phase;
+  };
+
+  // written by its own thread only, read by flush() after the threads stopped
+  struct ThreadBuffer {
+    int tid = 0;
+    std::string name;
+    std::vector<Record> records;
+    std::atomic<uint64_t> head{0};
+  };
+
+  ThreadBuffer* buffer();
+  void append(const Record& record);
+
+  static std::atomic<bool> enabled_;
+
+  std::string file_;
+  size_t buffer_size_ = 0;
+  uint64_t origin_ = 0;
+  std::mutex lock_;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, int> ids_;
+
+  friend class crdc::airi::common::Singleton<Tracer>;
+  DISALLOW_COPY_AND_ASSIGN(Tracer);
+};
+
+/**
+ * @brief a span from its construction to its destruction, nothing if disabled
+ */
+class TraceSpan {
+ public:
+  TraceSpan(int name, uint64_t utime)
+      : name_(name), utime_(utime), begin_(Tracer::enabled() ? Tracer::now() : 0) {}
+
+  ~TraceSpan() {
+    if (begin_ > 0) {
+      crdc::airi::common::Singleton<Tracer>::get()->span(name_, begin_, Tracer::now(), utime_);
+    }
+  }
+
+ private:
+  int name_;
+  uint64_t utime_;
+  uint64_t begin_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceSpan);
+};
+
+}  // namespace airi
+}  // namespace crdc
@@ -0,0 +1,139 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: work stealing pool
+
+#include "framework/work_stealing_pool.h"
+
+namespace crdc {
+namespace airi {
+
+// the index of the pool thread running on, -1 for the other threads
+static thread_local int current_idx = -1;
+
+WorkStealingPool::~WorkStealingPool() { stop(); }
+
+bool WorkStealingPool::in_pool() { return current_idx >= 0; }
+
+void WorkStealingPool::start(size_t num_threads) {
+  std::lock_guard<std::mutex> guard(start_lock_);
+  if (!threads_.empty()) {
+    return;
+  }
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  stop_ = false;
+  queues_.clear();
+  for (size_t i = 0; i < num_threads; ++i) {
+    queues_.emplace_back(new LocalQueue);
+  }
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(&WorkStealingPool::work, this, i);
+  }
+  LOG(INFO) << "WorkStealingPool started with " << num_threads << " threads.";
+}
+
+void WorkStealingPool::stop() {
+  std::lock_guard<std::mutex> guard(start_lock_);
+  if (threads_.empty()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(idle_lock_);
+    stop_ = true;
+  }
+  idle_cv_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+  threads_.clear();
+  LOG(INFO) << "WorkStealingPool stopped.";
+}
+
+void WorkStealingPool::submit(int priority, Task task) {
+  CHECK(!queues_.empty()) << "WorkStealingPool is not started.";
+  size_t idx = current_idx >= 0 ? current_idx
+                                : next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+  {
+    LocalQueue* queue = queues_[idx].get();
+    std::lock_guard<std::mutex> lock(queue->lock);
+    queue->heap.push(Item{priority, seq_.fetch_add(1, std::memory_order_relaxed),
+                          std::move(task)});
+    pending_.fetch_add(1, std::memory_order_seq_cst);
+  }
+  // pairs with the sleeping_ increment in work(), either the idle thread sees
+  // the pending task or it is seen sleeping here
+  if (sleeping_.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard<std::mutex> lock(idle_lock_);
+    idle_cv_.notify_one();
+  }
+}
+
+bool WorkStealingPool::pop(LocalQueue* queue, Item* item) {
+  if (queue->heap.empty()) {
+    return false;
+  }
+  *item = std::move(const_cast<Item&>(queue->heap.top()));
+  queue->heap.pop();
+  pending_.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool WorkStealingPool::take(size_t idx, Item* item) {
+  {
+    std::lock_guard<std::mutex> lock(queues_[idx]->lock);
+    if (pop(queues_[idx].get(), item)) {
+      return true;
+    }
+  }
+  // find the victim with the most urgent top task, then steal it
+  ItemLess less;
+  for (int retry = 0; retry < 2; ++retry) {
+    LocalQueue* victim = nullptr;
+    Item best{0, 0, nullptr};
+    for (size_t k = 1; k < queues_.size(); ++k) {
+      LocalQueue* queue = queues_[(idx + k) % queues_.size()].get();
+      std::lock_guard<std::mutex> lock(queue->lock);
+      if (queue->heap.empty()) {
+        continue;
+      }
+      const Item& top = queue->heap.top();
+      if (!victim || less(best, top)) {
+        victim = queue;
+        best.priority = top.priority;
+        best.seq = top.seq;
+      }
+    }
+    if (!victim) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(victim->lock);
+    if (pop(victim, item)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::work(size_t idx) {
+  current_idx = idx;
+  Item item;
+  while (!stop_) {
+    if (take(idx, &item)) {
+      item.task();
+      item.task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(idle_lock_);
+    sleeping_.fetch_add(1, std::memory_order_seq_cst);
+    idle_cv_.wait(lock, [this] {
+      return stop_ || pending_.load(std::memory_order_seq_cst) > 0;
+    });
+    sleeping_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  current_idx = -1;
+}
+
+}  // namespace airi
+}  // namespace crdc
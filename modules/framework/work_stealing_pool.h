@@ -0,0 +1,113 @@
+// Copyright (C) 2021 FengD
+// License: Modified BSD Software License Agreement
+// Author: Feng DING
+// Description: work stealing pool. The shared executor of the event workers which
+//              choose `executor: POOL`. The events become tasks of a fixed number of
+//              threads instead of a blocked thread for each trigger.
+
+#pragma once
+
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "common/common.h"
+
+namespace crdc {
+namespace airi {
+
+DECLARE_int32(executor_threads);
+
+class WorkStealingPool {
+ public:
+  using Task = std::function<void()>;
+
+  WorkStealingPool() = default;
+  ~WorkStealingPool();
+
+  /**
+   * @brief start the threads, called by the operators with pooled workers.
+   *        Only the first call starts the pool.
+   * @param [in] the number of the threads, 0 for the number of the cores
+   */
+  void start(size_t num_threads);
+
+  /**
+   * @brief stop and join the threads, the tasks not started are dropped
+   */
+  void stop();
+
+  /**
+   * @brief add a task. It goes to the queue of the calling thread if it is a
+   *        thread of the pool, so a downstream runs where its upstream ran.
+   * @param [in] the priority, lower is more urgent as the nice value
+   * @param [in] the task
+   */
+  void submit(int priority, Task task);
+
+  size_t num_threads() const { return queues_.size(); }
+
+  /**
+   * @brief whether the calling thread is a thread of the pool, which should never
+   *        wait for a task queued behind it
+   */
+  static bool in_pool();
+
+ private:
+  struct Item {
+    int priority;
+    uint64_t seq;
+    Task task;
+  };
+
+  struct ItemLess {
+    // the top of the heap is the most urgent and then the oldest one
+    bool operator()(const Item& a, const Item& b) const {
+      return a.priority != b.priority ? a.priority > b.priority : a.seq > b.seq;
+    }
+  };
+
+  struct alignas(64) LocalQueue {
+    ALIGNED_NEW(64);
+    std::mutex lock;
+    std::priority_queue<Item, std::vector<Item>, ItemLess> heap;
+  };
+
+  /**
+   * @brief the loop of the idx-th thread
+   */
+  void work(size_t idx);
+
+  /**
+   * @brief take the top task of the own queue, or steal the most urgent top task
+   *        of the other queues.
+   */
+  bool take(size_t idx, Item* item);
+
+  bool pop(LocalQueue* queue, Item* item);
+
+  std::vector<std::unique_ptr<LocalQueue>> queues_;
+  std::vector<std::thread> threads_;
+  std::mutex start_lock_;
+  std::atomic<bool> stop_{false};
+  std::atomic<uint64_t> seq_{0};
+  std::atomic<size_t> next_{0};
+  // the tasks in the queues
+  std::atomic<size_t> pending_{0};
+  // the threads waiting for tasks
+  std::atomic<size_t> sleeping_{0};
+  std::mutex idle_lock_;
+  std::condition_variable idle_cv_;
+
+  friend class crdc::airi::common::Singleton<WorkStealingPool>;
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingPool);
+};
+
+}  // namespace airi
+}  // namespace crdc